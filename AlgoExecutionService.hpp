@@ -18,10 +18,10 @@ template <typename T> class AlgoExecution {
   public:
     // ctor
     AlgoExecution() = default;
-    AlgoExecution(const T& _product, PricingSide _side, string _orderId,
-                  OrderType _orderType, double _price, long _visibleQuantity,
-                  long _hiddenQuantity, string _parentOrderId,
-                  bool _isChildOrder);
+    AlgoExecution(ProductHandle<T> _product, PricingSide _side,
+                  string _orderId, OrderType _orderType, TickPrice _price,
+                  long _visibleQuantity, long _hiddenQuantity,
+                  string _parentOrderId, bool _isChildOrder);
 
     // Get the order
     ExecutionOrder<T>* GetExecutionOrder() const;
@@ -31,9 +31,9 @@ template <typename T> class AlgoExecution {
 };
 
 template <typename T>
-AlgoExecution<T>::AlgoExecution(const T& _product, PricingSide _side,
+AlgoExecution<T>::AlgoExecution(ProductHandle<T> _product, PricingSide _side,
                                 string _orderId, OrderType _orderType,
-                                double _price, long _visibleQuantity,
+                                TickPrice _price, long _visibleQuantity,
                                 long _hiddenQuantity, string _parentOrderId,
                                 bool _isChildOrder) {
     executionOrder = new ExecutionOrder<T>(
@@ -51,18 +51,18 @@ template <typename T> class AlgoExecutionServiceListener;
 
 /**
  * Service for Algo Execution orders.
- * Keyed on product id.
+ * Keyed on product CUSIP, held by product index.
  * Type T is the product type.
  */
 template <typename T>
-class AlgoExecutionService : public Service<string, AlgoExecution<T>> {
+class AlgoExecutionService : public Service<Cusip, AlgoExecution<T>> {
   public:
     // ctor
     AlgoExecutionService();
     ~AlgoExecutionService();
 
     // Get data on our service given a key
-    AlgoExecution<T>& GetData(string _key);
+    AlgoExecution<T>& GetData(Cusip _key);
 
     // The callback that a Connector should invoke for any new or updated data
     void OnMessage(AlgoExecution<T>& _data);
@@ -77,34 +77,39 @@ class AlgoExecutionService : public Service<string, AlgoExecution<T>> {
     AlgoExecutionServiceListener<T>* GetListener();
 
     // Execute algo based on an order on a market, called by listener when
-    // adding process
+    // adding process. _emit(AlgoExecution<T>&) is handed the execution in
+    // place of the listeners.
     void AlgoExecutionTrade(OrderBook<T>& _orderBook);
+    template <typename F>
+    void AlgoExecutionTrade(OrderBook<T>& _orderBook, F _emit);
+
+    // Set whether orders are numbered, and their sides picked, per product,
+    // qualifying the order ids by CUSIP
+    void SetCountPerProduct(bool _perProduct);
 
   private:
-    map<string, AlgoExecution<T>> algoExecutions;
+    ProductTable<AlgoExecution<T>> algoExecutions;
     vector<ServiceListener<AlgoExecution<T>>*> listeners;
     AlgoExecutionServiceListener<T>* listener;
-    long executionCount;
+    ProductCounter executionCount;
 };
 
 template <typename T> AlgoExecutionService<T>::AlgoExecutionService() {
-    algoExecutions = map<string, AlgoExecution<T>>();
     listeners = vector<ServiceListener<AlgoExecution<T>>*>();
     listener = new AlgoExecutionServiceListener<T>(this);
-    executionCount = 0;
 }
 
 template <typename T> AlgoExecutionService<T>::~AlgoExecutionService() {}
 
 template <typename T>
-AlgoExecution<T>& AlgoExecutionService<T>::GetData(string _id) {
-    return algoExecutions[_id];
+AlgoExecution<T>& AlgoExecutionService<T>::GetData(Cusip _id) {
+    return algoExecutions[GetProductRegistry<T>().At(_id)];
 }
 
 template <typename T>
 void AlgoExecutionService<T>::OnMessage(AlgoExecution<T>& _data) {
-    algoExecutions[_data.GetExecutionOrder()->GetProduct().GetProductId()] =
-        _data;
+    algoExecutions.Insert(
+        _data.GetExecutionOrder()->GetProductHandle().GetIndex(), _data);
 }
 
 template <typename T>
@@ -128,24 +133,36 @@ AlgoExecutionServiceListener<T>* AlgoExecutionService<T>::GetListener() {
 // spread
 template <typename T>
 void AlgoExecutionService<T>::AlgoExecutionTrade(OrderBook<T>& _orderBook) {
-    // T _product = _orderBook.GetProduct();
-    string _productId = _orderBook.GetProduct().GetProductId();
+    AlgoExecutionTrade(_orderBook,
+                       ListenerEmitter<AlgoExecution<T>>(listeners));
+}
+
+template <typename T>
+template <typename F>
+void AlgoExecutionService<T>::AlgoExecutionTrade(OrderBook<T>& _orderBook,
+                                                 F _emit) {
+    ProductHandle<T> _product = _orderBook.GetProductHandle();
     PricingSide _side;
-    string _orderId = "AlgoExec" + to_string(executionCount);
-    double _price;
+    TickPrice _price;
     long _quantity;
 
-    Order bid_order = _orderBook.GetBidOffer().GetBidOrder();
-    Order offer_order = _orderBook.GetBidOffer().GetOfferOrder();
+    const BidOffer& _bidOffer = _orderBook.GetBidOffer();
+    const Order& bid_order = _bidOffer.GetBidOrder();
+    const Order& offer_order = _bidOffer.GetOfferOrder();
 
-    double bid_price = bid_order.GetPrice();
+    TickPrice bid_price = bid_order.GetPrice();
     long bid_quantity = bid_order.GetQuantity();
-    double offer_price = offer_order.GetPrice();
+    TickPrice offer_price = offer_order.GetPrice();
     long offer_quantity = offer_order.GetQuantity();
 
     // Only trade when the spread <= 1/128
-    if (offer_price - bid_price <= 1.0 / 128.0) {
-        if (executionCount % 2) {
+    if (offer_price - bid_price <= TickPrice(TICKS_PER_POINT / 128)) {
+        long& _executionCount = executionCount[_product.GetIndex()];
+        string _orderId = "AlgoExec" + to_string(_executionCount);
+        if (executionCount.IsPerProduct()) {
+            _orderId = _product.Get().GetProductId() + "_" + _orderId;
+        }
+        if (_executionCount % 2) {
             _price = bid_price;
             _quantity = bid_quantity;
             _side = BID;
@@ -154,20 +171,22 @@ void AlgoExecutionService<T>::AlgoExecutionTrade(OrderBook<T>& _orderBook) {
             _quantity = offer_quantity;
             _side = OFFER;
         }
-        executionCount++;
+        _executionCount++;
 
-        AlgoExecution<T> algoOrder(_orderBook.GetProduct(), _side, _orderId,
-                                   MARKET, _price, _quantity, 0,
-                                   "PARENT_ORDER_ID", false);
-        algoExecutions[_productId] = algoOrder;
+        AlgoExecution<T> algoOrder(_product, _side, _orderId, MARKET, _price,
+                                   _quantity, 0, "PARENT_ORDER_ID", false);
+        algoExecutions.Insert(_product.GetIndex(), algoOrder);
 
         // notify the listners
-        for (auto& l : listeners) {
-            l->ProcessAdd(algoOrder);
-        }
+        _emit(algoOrder);
     }
 }
 
+template <typename T>
+void AlgoExecutionService<T>::SetCountPerProduct(bool _perProduct) {
+    executionCount.SetPerProduct(_perProduct);
+}
+
 /**
  * Service listener connection algoexecution to BondMarketDataService
  */
@@ -179,6 +198,7 @@ class AlgoExecutionServiceListener : public ServiceListener<OrderBook<T>> {
 
     // Listener callback to process an add event to the Service
     void ProcessAdd(OrderBook<T>& _data);
+    template <typename F> void ProcessAdd(OrderBook<T>& _data, F _emit);
 
     // Listener callback to process a remove event to the Service
     void ProcessRemove(OrderBook<T>& _data);
@@ -202,6 +222,13 @@ void AlgoExecutionServiceListener<T>::ProcessAdd(OrderBook<T>& _data) {
     service->AlgoExecutionTrade(_data);
 }
 
+template <typename T>
+template <typename F>
+void AlgoExecutionServiceListener<T>::ProcessAdd(OrderBook<T>& _data,
+                                                 F _emit) {
+    service->AlgoExecutionTrade(_data, _emit);
+}
+
 // No implementation
 template <typename T>
 void AlgoExecutionServiceListener<T>::ProcessRemove(OrderBook<T>& _data) {}
@@ -22,7 +22,7 @@ class AlgoStream
 public:
     // ctor
     AlgoStream() = default;
-    AlgoStream(const T& _product, const PriceStreamOrder& _bidOrder, const PriceStreamOrder& _offerOrder);
+    AlgoStream(ProductHandle<T> _product, const PriceStreamOrder& _bidOrder, const PriceStreamOrder& _offerOrder);
 
 
     // Get the price stream
@@ -33,7 +33,7 @@ private:
 };
 
 template<typename T>
-AlgoStream<T>::AlgoStream(const T& _product, const PriceStreamOrder& _bidOrder, const PriceStreamOrder& _offerOrder)
+AlgoStream<T>::AlgoStream(ProductHandle<T> _product, const PriceStreamOrder& _bidOrder, const PriceStreamOrder& _offerOrder)
 {
     priceStream = new PriceStream<T>(_product, _bidOrder, _offerOrder);
 }
@@ -51,11 +51,11 @@ class AlgoStreamingServiceListener;
 
 /**
 * Service for Algo Streaming orders.
-* Keyed on product id.
+* Keyed on product CUSIP, held by product index.
 * Type T is the product type.
 */
 template<typename T>
-class AlgoStreamingService : public Service<string, AlgoStream<T>>
+class AlgoStreamingService : public Service<Cusip, AlgoStream<T>>
 {
 public:
 
@@ -64,7 +64,7 @@ public:
     ~AlgoStreamingService();
 
     // Get data on our service given a key
-    AlgoStream<T>& GetData(string _key);
+    AlgoStream<T>& GetData(Cusip _key);
 
     // The callback that a Connector should invoke for any new or updated data
     void OnMessage(AlgoStream<T>& _data);
@@ -79,37 +79,46 @@ public:
     ServiceListener<Price<T>>* GetListener();
 
     // Publish two-way prices
+    // _emit(AlgoStream<T>&) is handed the stream in place of the listeners.
     void AlgoPublishPrice(Price<T>& _price);
+    template<typename F>
+    void AlgoPublishPrice(Price<T>& _price, F _emit);
+
+    // Publish two-way prices for a batch of prices, flowing the streams to
+    // the listeners as one batch
+    void AlgoPublishPrices(Price<T>* _prices, size_t _count);
+
+    // Set whether the sizes alternate per product
+    void SetCountPerProduct(bool _perProduct);
 
 private:
-    map<string, AlgoStream<T>> algoStreams;
+    ProductTable<AlgoStream<T>> algoStreams;
     vector<ServiceListener<AlgoStream<T>>*> listeners;
     ServiceListener<Price<T>>* listener;
-    long pricePublishCount;
+    ProductCounter pricePublishCount;
 };
 
 template<typename T>
 AlgoStreamingService<T>::AlgoStreamingService()
 {
-    algoStreams = map<string, AlgoStream<T>>();
     listeners = vector<ServiceListener<AlgoStream<T>>*>();
     listener = new AlgoStreamingServiceListener<T>(this);
-    pricePublishCount = 0;
 }
 
 template<typename T>
 AlgoStreamingService<T>::~AlgoStreamingService() {}
 
 template<typename T>
-AlgoStream<T>& AlgoStreamingService<T>::GetData(string _key)
+AlgoStream<T>& AlgoStreamingService<T>::GetData(Cusip _key)
 {
-    return algoStreams[_key];
+    return algoStreams[GetProductRegistry<T>().At(_key)];
 }
 
 template<typename T>
 void AlgoStreamingService<T>::OnMessage(AlgoStream<T>& _data)
 {
-    algoStreams[_data.GetPriceStream()->GetProduct().GetProductId()] = _data;
+    algoStreams.Insert(_data.GetPriceStream()->GetProductHandle().GetIndex(),
+                       _data);
 }
 
 template<typename T>
@@ -133,27 +142,53 @@ ServiceListener<Price<T>>* AlgoStreamingService<T>::GetListener()
 template<typename T>
 void AlgoStreamingService<T>::AlgoPublishPrice(Price<T>& _price)
 {
-    T _product = _price.GetProduct();
-    string _productId = _product.GetProductId();
+    AlgoPublishPrice(_price, ListenerEmitter<AlgoStream<T>>(listeners));
+}
+
+template<typename T>
+template<typename F>
+void AlgoStreamingService<T>::AlgoPublishPrice(Price<T>& _price, F _emit)
+{
+    ProductHandle<T> _product = _price.GetProductHandle();
 
-    double midPrice = _price.GetMid();
-    double spread = _price.GetBidOfferSpread();
-    double _bidPrice = midPrice - spread / 2.0;
-    double _offerPrice = midPrice + spread / 2.0;
-    long _visibleQuantity = (pricePublishCount % 2 + 1) * 1000000;
+    TickPrice _bidPrice = _price.GetBid();
+    TickPrice _offerPrice = _price.GetOffer();
+    long& _pricePublishCount = pricePublishCount[_product.GetIndex()];
+    long _visibleQuantity = (_pricePublishCount % 2 + 1) * 1000000;
     long _hiddenQuantity = _visibleQuantity * 2;
 
-    pricePublishCount++;
+    _pricePublishCount++;
     PriceStreamOrder _bidOrder(_bidPrice, _visibleQuantity, _hiddenQuantity, BID);
     PriceStreamOrder _offerOrder(_offerPrice, _visibleQuantity, _hiddenQuantity, OFFER);
     AlgoStream<T> _algoStream(_product, _bidOrder, _offerOrder);
-    algoStreams[_productId] = _algoStream;
+    algoStreams.Insert(_product.GetIndex(), _algoStream);
 
-    for (auto& l : listeners)
+    _emit(_algoStream);
+}
+
+template<typename T>
+void AlgoStreamingService<T>::SetCountPerProduct(bool _perProduct)
+{
+    pricePublishCount.SetPerProduct(_perProduct);
+}
+
+template<typename T>
+void AlgoStreamingService<T>::AlgoPublishPrices(Price<T>* _prices, size_t _count)
+{
+    vector<AlgoStream<T>> _algoStreams;
+    _algoStreams.reserve(_count);
+    for (size_t i = 0; i < _count; i++)
     {
-        l->ProcessAdd(_algoStream);
+        AlgoPublishPrice(_prices[i], [&_algoStreams](AlgoStream<T>& _algoStream)
+        {
+            _algoStreams.push_back(_algoStream);
+        });
     }
 
+    for (auto& l : listeners)
+    {
+        l->ProcessAddBatch(_algoStreams.data(), _algoStreams.size());
+    }
 }
 
 
@@ -175,6 +210,9 @@ public:
     // Listener callback to process an add event to the Service
     void ProcessAdd(Price<T>& _data);
 
+    // Listener callback to process add events for a batch of prices
+    void ProcessAddBatch(Price<T>* _data, size_t _count);
+
     // Listener callback to process a remove event to the Service
     void ProcessRemove(Price<T>& _data);
 
@@ -195,6 +233,12 @@ void AlgoStreamingServiceListener<T>::ProcessAdd(Price<T>& _data)
     service->AlgoPublishPrice(_data);
 }
 
+template<typename T>
+void AlgoStreamingServiceListener<T>::ProcessAddBatch(Price<T>* _data, size_t _count)
+{
+    service->AlgoPublishPrices(_data, _count);
+}
+
 template<typename T>
 void AlgoStreamingServiceListener<T>::ProcessRemove(Price<T>& _data) {}
 
@@ -34,22 +34,22 @@ void GeneratePrices() {
         return;
     }
     const int orderSize = DATASIZE; // Number of prices per security
-    const double minTick = 1 / 256.0;
-    const double LOW_LIMIT = 99.0 + minTick * 2.0;
-    const double UPPER_LIMIT = 101.0 - minTick * 2.0;
+    const TickPrice minTick(1);
+    const TickPrice LOW_LIMIT = TickPrice(99 * TICKS_PER_POINT) + minTick * 2;
+    const TickPrice UPPER_LIMIT = TickPrice(101 * TICKS_PER_POINT) - minTick * 2;
 
-    for (const auto& [mat, bond] : bondMap) {
-        // cout << "Generating prices for security " << bond.first << " ...\n";
+    for (const BondReference& bond : BOND_REFERENCES) {
+        // cout << "Generating prices for security " << bond.cusip << " ...\n";
 
-        double central_price = LOW_LIMIT;
+        TickPrice central_price = LOW_LIMIT;
         bool up = true;
         thread_local random_device rd;
         thread_local mt19937_64 gen(rd());
         thread_local bernoulli_distribution d(0.5);
 
         for (int i = 0; i < orderSize; i++) {
-            double ask = central_price + minTick;
-            double bid = central_price - minTick;
+            TickPrice ask = central_price + minTick;
+            TickPrice bid = central_price - minTick;
 
             if (d(gen))
                 ask += minTick;
@@ -62,7 +62,7 @@ void GeneratePrices() {
             if (central_price <= LOW_LIMIT)
                 up = true;
 
-            file << bond.first << "," << price2string(bid) << ","
+            file << bond.cusip << "," << price2string(bid) << ","
                  << price2string(ask) << endl;
 
         }
@@ -83,27 +83,27 @@ void GenerateMarketData() {
     }
 
     const int orderSize = DATASIZE / 10;  // Number of order book updates per security
-    const double minTick = 1.0 / 256.0;
-    const double basePrice = 99.0;  // Base price for oscillation
+    const TickPrice minTick(1);
+    const TickPrice basePrice(99 * TICKS_PER_POINT);  // Base price for oscillation
 
-    for (const auto& [mat, bond] : bondMap) {
-        double price = basePrice;
+    for (const BondReference& bond : BOND_REFERENCES) {
+        TickPrice price = basePrice;
         bool increasing = true;
 
         for (int i = 0; i < orderSize; ++i) {
             for (int level = 1; level <= 5; ++level) {
-                double spread = level * minTick;
-                double bidPrice = price - spread;
-                double askPrice = price + spread;
+                TickPrice spread = minTick * level;
+                TickPrice bidPrice = price - spread;
+                TickPrice askPrice = price + spread;
                 int size = level * 10000000;  // 10 million, 20 million, etc.
 
-                file << bond.first << "," << price2string(bidPrice) << "," << size << ",BID" <<endl;
-                file << bond.first << "," << price2string(askPrice) << "," << size << ",OFFER" << endl;
+                file << bond.cusip << "," << price2string(bidPrice) << "," << size << ",BID" <<endl;
+                file << bond.cusip << "," << price2string(askPrice) << "," << size << ",OFFER" << endl;
             }
 
             // Oscillate price
-            if (price >= 101.0 - minTick) increasing = false;
-            if (price <= 99.0 + minTick) increasing = true;
+            if (price >= TickPrice(101 * TICKS_PER_POINT) - minTick) increasing = false;
+            if (price <= basePrice + minTick) increasing = true;
             price += increasing ? minTick : -minTick;
         }
     }
@@ -123,18 +123,18 @@ void GenerateInquiries() {
     thread_local random_device rd;
     thread_local mt19937_64 gen(rd());
     thread_local uniform_real_distribution<double> d(0.0, 1.0);
-    const double minTick = 1 / 256.0;
+    const TickPrice minTick(1);
 
-    for (const auto& [mat, bond] : bondMap) {
+    for (const BondReference& bond : BOND_REFERENCES) {
         for (int i = 0; i < 10; ++i) {
             int _n = (int)(d(gen) * 512);
-            double _price = 99.0 + minTick * (double)_n;
+            TickPrice _price = TickPrice(99 * TICKS_PER_POINT) + minTick * _n;
             
-            string inquiryId = bond.first + "_INQ" + to_string(i);
+            string inquiryId = string(bond.cusip) + "_INQ" + to_string(i);
             string side = (i % 2 == 0) ? "BUY" : "SELL";
             int quantity = ((i % 5) + 1) * 1000000;  // 1 million, 2 million, etc.
             
-            file << inquiryId << "," << bond.first << "," << side << "," << quantity << "," << price2string(_price) << ",RECEIVED" << endl;
+            file << inquiryId << "," << bond.cusip << "," << side << "," << quantity << "," << price2string(_price) << ",RECEIVED" << endl;
         }
     }
 
@@ -153,11 +153,11 @@ void GenerateTrades() {
     thread_local random_device rd;
     thread_local mt19937_64 gen(rd());
     thread_local uniform_real_distribution<double> d(0.0, 1.0);
-    const double minTick = 1 / 256.0;
+    const TickPrice minTick(1);
 
-    for (const auto& [mat, bond] : bondMap) {
+    for (const BondReference& bond : BOND_REFERENCES) {
         for (int i = 0; i < 10; ++i) {
-            string tradeId = bond.first + "_TRADE" + to_string(i);
+            string tradeId = string(bond.cusip) + "_TRADE" + to_string(i);
             string side = (i % 2 == 0) ? "BUY" : "SELL";
             int quantity = ((i % 5) + 1) * 1000000;  // 1 million, 2 million, etc.
             
@@ -165,9 +165,9 @@ void GenerateTrades() {
             string _book_name = "TRSY" + to_string(_market);
             
             int _n = (int)(d(gen) * 512);
-            double _price = 99.0 + minTick * (double)_n;
+            TickPrice _price = TickPrice(99 * TICKS_PER_POINT) + minTick * _n;
             
-            file << bond.first << "," << tradeId << "," << price2string(_price) << ","<< _book_name <<"," << quantity << "," << side<< endl;
+            file << bond.cusip << "," << tradeId << "," << price2string(_price) << ","<< _book_name <<"," << quantity << "," << side<< endl;
         }
     }
 
@@ -27,7 +27,7 @@ class GUIListener;
 
 // GUIService class definition
 template<typename T>
-class GUIService : Service<string, Price<T>>  {
+class GUIService : Service<Cusip, Price<T>>  {
     
 public:
     // Constructor
@@ -37,7 +37,7 @@ public:
     ~GUIService();
 
     // Get data from the service given a key
-    Price<T>& GetData(string _key);
+    Price<T>& GetData(Cusip _key);
 
     // The callback that a Connector should invoke for any new or updated data
     void OnMessage(Price<T>& _data);
@@ -61,7 +61,7 @@ public:
     void SetTime(int _time);
 
 private:
-    map<string, Price<T>> GUIs;
+    ProductTable<Price<T>> GUIs;
     vector<ServiceListener<Price<T>>*> listeners;
     GUIConnector<T>* connector;
     ServiceListener<Price<T>>* listener;
@@ -70,7 +70,6 @@ private:
 
 template<typename T>
 GUIService<T>::GUIService() {
-    GUIs = map<string, Price<T>>();
     listeners = vector<ServiceListener<Price<T>>*>();
     connector = new GUIConnector<T>(this);
     listener = new GUIListener<T>(this);
@@ -81,14 +80,13 @@ template<typename T>
 GUIService<T>::~GUIService() {}
 
 template<typename T>
-Price<T>& GUIService<T>::GetData(string _key) {
-    return GUIs[_key];
+Price<T>& GUIService<T>::GetData(Cusip _key) {
+    return GUIs[GetProductRegistry<T>().At(_key)];
 }
 
 template<typename T>
 void GUIService<T>::OnMessage(Price<T>& _data) {
-    string product_id = _data.GetProduct().GetProductId();
-    GUIs[product_id] = _data;
+    GUIs.Insert(_data.GetProductHandle().GetIndex(), _data);
     connector->Publish(_data);
 }
 
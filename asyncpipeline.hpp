@@ -0,0 +1,313 @@
+/**
+ * asyncpipeline.hpp
+ * Defines stages running listeners on threads of their own, fed through
+ * rings by the services upstream of them.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef ASYNC_PIPELINE_HPP
+#define ASYNC_PIPELINE_HPP
+
+#include "soa.hpp"
+#include "boundedqueue.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Values queued ahead of each stage before its producer has to wait
+constexpr size_t ASYNC_STAGE_CAPACITY = 1024;
+
+// Empty polls of a stage spinning, then yielding, before it sleeps between
+// polls
+constexpr int ASYNC_STAGE_SPINS = 64;
+constexpr int ASYNC_STAGE_YIELDS = 1024;
+constexpr int ASYNC_STAGE_SLEEP_MICROSECONDS = 50;
+
+// Wait after the given number of empty polls in a row: spin at first, then
+// yield, then sleep
+void BackOff(int _polls) {
+    if (_polls <= ASYNC_STAGE_SPINS) {
+        return;
+    } else if (_polls <= ASYNC_STAGE_SPINS + ASYNC_STAGE_YIELDS) {
+        this_thread::yield();
+    } else {
+        this_thread::sleep_for(
+            chrono::microseconds(ASYNC_STAGE_SLEEP_MICROSECONDS));
+    }
+}
+
+/**
+ * A stage of a pipeline, whatever the type of data it carries.
+ */
+class AsyncStageBase {
+
+  public:
+    virtual ~AsyncStageBase() {}
+
+    // Check whether everything queued on the stage has been processed
+    virtual bool IsIdle() const = 0;
+
+    // Get the number of values processed or dropped so far
+    virtual uint64_t GetCompleted() const = 0;
+
+    // Get the number of values waiting to be processed
+    virtual size_t GetDepth() const = 0;
+
+    // Get the number of values dropped so far
+    virtual uint64_t GetDropped() const = 0;
+};
+
+/**
+ * Listener queueing add events on a bounded queue for a worker thread of its
+ * own, which hands them on to the wrapped listener. Registered on a service
+ * in place of that listener, so the service carries on while the listener and
+ * everything downstream of it runs.
+ * Values are copied into the queue; whatever has queued up by the time the
+ * worker looks is handed to the listener as one batch. A full queue applies
+ * the overflow policy of the stage: blocking stages hold the service back,
+ * the others drop values so a slow listener never stalls it.
+ * The queue has a single producer: only one thread may add events at a time.
+ * Type V is the data type, and type K the type of its conflation key.
+ */
+template <typename V, typename K = size_t>
+class AsyncStage : public AsyncStageBase, public ServiceListener<V> {
+
+  public:
+    // ctor for a stage running a listener, starting its worker
+    AsyncStage(ServiceListener<V>* _listener, OverflowPolicy _policy = BLOCK,
+               function<K(const V&)> _key = nullptr);
+
+    // Process everything queued, then stop the worker
+    ~AsyncStage();
+
+    // Listener callback to process an add event to the Service
+    void ProcessAdd(V& _data);
+
+    // Listener callback to process a remove event to the Service
+    void ProcessRemove(V& _data);
+
+    // Listener callback to process an update event to the Service
+    void ProcessUpdate(V& _data);
+
+    // Listener callback to process add events for a batch of data
+    void ProcessAddBatch(V* _data, size_t _count);
+
+    // Check whether everything queued on the stage has been processed
+    bool IsIdle() const;
+
+    // Get the number of values processed or dropped so far
+    uint64_t GetCompleted() const;
+
+    // Get the number of values waiting to be processed
+    size_t GetDepth() const;
+
+    // Get the number of values dropped so far
+    uint64_t GetDropped() const;
+
+  private:
+    // Take values off the queue and process them until stopped
+    void Run();
+
+    ServiceListener<V>* listener;
+    BoundedQueue<V, K> queue;
+    // counted before a value is pushed, so it never trails completed
+    atomic<uint64_t> enqueued;
+    atomic<uint64_t> completed;
+    atomic<bool> stopping;
+    thread worker;
+};
+
+/**
+ * The stages of an asynchronous pipeline, which runs each staged listener,
+ * and so the service behind it, on a thread of its own. Disabled, it stages
+ * nothing and every listener runs on the thread of its service.
+ */
+class AsyncPipeline {
+
+  public:
+    // ctor for a pipeline, staging listeners only when enabled
+    AsyncPipeline(bool _enabled);
+
+    // Drain the pipeline, then stop its stages
+    ~AsyncPipeline();
+
+    // Get the listener to register on a service: a new stage running the
+    // listener, or the listener itself when the pipeline is disabled
+    // Conflating stages conflate values on _key.
+    template <typename V, typename K = size_t>
+    ServiceListener<V>* Stage(ServiceListener<V>* _listener,
+                              OverflowPolicy _policy = BLOCK,
+                              function<K(const V&)> _key = nullptr);
+
+    // Take ownership of a stage, drained and stopped with the others
+    void Adopt(AsyncStageBase* _stage);
+
+    // Check whether the pipeline stages listeners
+    bool IsEnabled() const;
+
+    // Wait until every stage has processed everything queued on it,
+    // including what the stages upstream of it queued while draining
+    void Drain();
+
+    // Get the number of values dropped so far, summed over the stages
+    uint64_t GetDropped() const;
+
+    // Get the deepest queue of the stages
+    size_t GetMaxDepth() const;
+
+  private:
+    bool enabled;
+    vector<unique_ptr<AsyncStageBase>> stages;
+};
+
+template <typename V, typename K>
+AsyncStage<V, K>::AsyncStage(ServiceListener<V>* _listener,
+                             OverflowPolicy _policy,
+                             function<K(const V&)> _key)
+    : listener(_listener), queue(ASYNC_STAGE_CAPACITY, _policy, _key),
+      enqueued(0),
+      completed(0), stopping(false), worker(&AsyncStage<V, K>::Run, this) {}
+
+template <typename V, typename K> AsyncStage<V, K>::~AsyncStage() {
+    stopping.store(true);
+    worker.join();
+}
+
+template <typename V, typename K>
+void AsyncStage<V, K>::ProcessAdd(V& _data) {
+    enqueued.fetch_add(1);
+    queue.Push(_data);
+}
+
+template <typename V, typename K>
+void AsyncStage<V, K>::ProcessRemove(V& _data) {}
+
+template <typename V, typename K>
+void AsyncStage<V, K>::ProcessUpdate(V& _data) {}
+
+template <typename V, typename K>
+void AsyncStage<V, K>::ProcessAddBatch(V* _data, size_t _count) {
+    enqueued.fetch_add(_count);
+    for (size_t i = 0; i < _count; i++) {
+        queue.Push(_data[i]);
+    }
+}
+
+template <typename V, typename K>
+bool AsyncStage<V, K>::IsIdle() const {
+    return GetCompleted() == enqueued.load();
+}
+
+template <typename V, typename K>
+uint64_t AsyncStage<V, K>::GetCompleted() const {
+    return completed.load() + queue.GetDropped();
+}
+
+template <typename V, typename K>
+size_t AsyncStage<V, K>::GetDepth() const {
+    return queue.GetDepth();
+}
+
+template <typename V, typename K>
+uint64_t AsyncStage<V, K>::GetDropped() const {
+    return queue.GetDropped();
+}
+
+template <typename V, typename K>
+void AsyncStage<V, K>::Run() {
+    vector<V> _batch;
+    _batch.reserve(CONNECTOR_BATCH_SIZE);
+    int _polls = 0;
+    while (true) {
+        // stopping is checked before polling, so nothing pushed before the
+        // stop is left behind
+        bool _stopping = stopping.load();
+        queue.PopBatch(_batch, CONNECTOR_BATCH_SIZE);
+
+        if (!_batch.empty()) {
+            if (_batch.size() == 1) {
+                listener->ProcessAdd(_batch[0]);
+            } else {
+                listener->ProcessAddBatch(_batch.data(), _batch.size());
+            }
+            completed.fetch_add(_batch.size());
+            _batch.clear();
+            _polls = 0;
+        } else if (_stopping) {
+            return;
+        } else {
+            BackOff(++_polls);
+        }
+    }
+}
+
+AsyncPipeline::AsyncPipeline(bool _enabled) : enabled(_enabled), stages() {}
+
+AsyncPipeline::~AsyncPipeline() {
+    Drain();
+    stages.clear();
+}
+
+template <typename V, typename K>
+ServiceListener<V>* AsyncPipeline::Stage(ServiceListener<V>* _listener,
+                                         OverflowPolicy _policy,
+                                         function<K(const V&)> _key) {
+    if (!enabled) {
+        return _listener;
+    }
+    AsyncStage<V, K>* _stage =
+        new AsyncStage<V, K>(_listener, _policy, _key);
+    Adopt(_stage);
+    return _stage;
+}
+
+void AsyncPipeline::Adopt(AsyncStageBase* _stage) {
+    stages.emplace_back(_stage);
+}
+
+bool AsyncPipeline::IsEnabled() const { return enabled; }
+
+void AsyncPipeline::Drain() {
+    // the pipeline is drained once a pass finds every stage idle and no
+    // value processed since the previous pass, which would have been queued
+    // on another stage
+    uint64_t _previous = UINT64_MAX;
+    while (true) {
+        bool _idle = true;
+        uint64_t _completed = 0;
+        for (auto& s : stages) {
+            _completed += s->GetCompleted();
+            _idle = s->IsIdle() && _idle;
+        }
+        if (_idle && _completed == _previous) {
+            return;
+        }
+        _previous = _completed;
+        this_thread::yield();
+    }
+}
+
+uint64_t AsyncPipeline::GetDropped() const {
+    uint64_t _dropped = 0;
+    for (auto& s : stages) {
+        _dropped += s->GetDropped();
+    }
+    return _dropped;
+}
+
+size_t AsyncPipeline::GetMaxDepth() const {
+    size_t _depth = 0;
+    for (auto& s : stages) {
+        _depth = max(_depth, s->GetDepth());
+    }
+    return _depth;
+}
+
+#endif
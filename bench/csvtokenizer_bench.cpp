@@ -0,0 +1,144 @@
+//
+//  csvtokenizer_bench.cpp
+//  TradingSystem
+//
+//  Throughput of splitting input feeds into fields, in GB/s:
+//  the getline/stringstream path the connectors used to take, a scalar
+//  per-line split and the block tokenizer with each scanner.
+//
+//  Usage: csvtokenizer_bench [input file]
+//  Without a file a marketdata.txt-like buffer of about 128MB is generated.
+//
+
+#include "../csvtokenizer.hpp"
+#include "../mappedfile.hpp"
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Build a buffer shaped like marketdata.txt
+string GenerateBuffer(size_t _size) {
+    string _buffer;
+    _buffer.reserve(_size + 64);
+    long i = 0;
+    while (_buffer.size() < _size) {
+        _buffer += "91282CJL6,99-";
+        _buffer += to_string(10 + i % 22);
+        _buffer += "+,";
+        _buffer += to_string((i % 5 + 1) * 10000000);
+        _buffer += i % 2 ? ",OFFER\n" : ",BID\n";
+        i++;
+    }
+    return _buffer;
+}
+
+// Run a splitter a few times and print its best throughput
+void Measure(const string& _name, size_t _bytes, function<size_t()> _run) {
+    double _best = 0.0;
+    size_t _fields = 0;
+    for (int r = 0; r < 5; r++) {
+        auto _start = chrono::steady_clock::now();
+        _fields = _run();
+        chrono::duration<double> _elapsed = chrono::steady_clock::now() - _start;
+        double _rate = _bytes / _elapsed.count() / 1e9;
+        if (_rate > _best) {
+            _best = _rate;
+        }
+    }
+    cout << _name << ": " << _best << " GB/s (" << _fields << " fields)"
+         << endl;
+}
+
+int main(int argc, char* argv[]) {
+    string _generated;
+    const char* _begin;
+    const char* _end;
+    MappedFile* _file = nullptr;
+    if (argc > 1) {
+        _file = new MappedFile(argv[1]);
+        _begin = _file->GetData();
+        _end = _begin + _file->GetSize();
+    } else {
+        _generated = GenerateBuffer(size_t(128) << 20);
+        _begin = _generated.data();
+        _end = _begin + _generated.size();
+    }
+    size_t _bytes = _end - _begin;
+    cout << "Input: " << _bytes << " bytes" << endl;
+
+    Measure("getline + stringstream", _bytes, [&]() {
+        istringstream _data(string(_begin, _end));
+        size_t _fields = 0;
+        string line;
+        while (getline(_data, line)) {
+            stringstream lineStream(line);
+            string tmp;
+            vector<string> vecs;
+            while (getline(lineStream, tmp, ',')) {
+                vecs.push_back(tmp);
+            }
+            _fields += vecs.size();
+        }
+        return _fields;
+    });
+
+    Measure("per-line SplitFields", _bytes, [&]() {
+        size_t _fields = 0;
+        const char* p = _begin;
+        string_view vecs[8];
+        while (p < _end) {
+            const char* _newline =
+                static_cast<const char*>(memchr(p, '\n', _end - p));
+            const char* _lineEnd = _newline != nullptr ? _newline : _end;
+            _fields += SplitFields(string_view(p, _lineEnd - p), vecs, 8);
+            p = _lineEnd + 1;
+        }
+        return _fields;
+    });
+
+    vector<pair<string, CsvBlockScanner>> _scanners{
+        {"TokenizeCsv scalar", ScanCsvBlockScalar}};
+#ifdef CSV_TOKENIZER_X86
+    _scanners.push_back({"TokenizeCsv SSE2", ScanCsvBlockSSE2});
+    if (__builtin_cpu_supports("avx2")) {
+        _scanners.push_back({"TokenizeCsv AVX2", ScanCsvBlockAVX2});
+    }
+#endif
+    for (auto& _scanner : _scanners) {
+        Measure(_scanner.first, _bytes, [&]() {
+            vector<uint32_t> _separators;
+            size_t _fields = 0;
+            // whole lines of about 1MB, as LineSource hands them over
+            const char* p = _begin;
+            while (p < _end) {
+                const char* _windowEnd = p + LINE_SOURCE_WINDOW < _end
+                                             ? p + LINE_SOURCE_WINDOW
+                                             : _end;
+                _separators.clear();
+                TokenizeCsv(p, _windowEnd, _separators, _scanner.second);
+                _fields += _separators.size();
+                p = _windowEnd;
+            }
+            return _fields;
+        });
+    }
+
+    Measure("LineSource::GetFields", _bytes, [&]() {
+        LineSource _source(_begin, _end);
+        string_view vecs[8];
+        size_t _fields = 0;
+        int _count;
+        while ((_count = _source.GetFields(vecs, 8)) >= 0) {
+            _fields += _count;
+        }
+        return _fields;
+    });
+
+    delete _file;
+    return 0;
+}
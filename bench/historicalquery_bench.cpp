@@ -0,0 +1,120 @@
+//
+//  historicalquery_bench.cpp
+//  TradingSystem
+//
+//  Latency of getting the positions of one product over a time window out of
+//  a historical data file: scanning the text file line by line, and querying
+//  the columnar file through its block index.
+//
+//  Usage: historicalquery_bench [records] [directory]
+//  By default 1000000 position records, spread over the bonds a few
+//  microseconds apart, are written to both formats in the current directory
+//  and removed afterwards. The window covers the middle 1% of the records.
+//
+
+#include "../historicalquery.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Stamp of the first record, and the microseconds between records
+constexpr int64_t BENCH_START = 1767225600000000;
+constexpr int64_t BENCH_STEP = 7;
+
+// Write position records to a text file as the connector does, and to a
+// columnar file
+void WriteFiles(size_t _count, const string& _text, const string& _columnar) {
+    const ProductRegistry<Bond>& _bonds = GetProductRegistry<Bond>();
+    vector<string> _books{"TRSY1", "TRSY2", "TRSY3"};
+    BufferedWriter _textWriter(_text);
+    BufferedWriter _columnarWriter(_columnar);
+    ColumnarWriter<Position<Bond>> _writer(_columnarWriter);
+    for (size_t i = 0; i < _count; i++) {
+        Position<Bond> _position(ProductIndex(i % _bonds.GetSize()));
+        _position.AddPosition(_books[i % 3], (i % 50 + 1) * 1000000);
+        int64_t _time = BENCH_START + i * BENCH_STEP;
+        _writer.Add(_position, _time);
+
+        _textWriter.Append(to_simple_string(FromMicroseconds(_time)));
+        _textWriter.Append(',');
+        for (auto& s : _position.PrintFunction()) {
+            _textWriter.Append(s);
+            _textWriter.Append(',');
+        }
+        _textWriter.Append('\n');
+    }
+}
+
+// Count the records of a product in a window by scanning the text file
+size_t ScanText(const string& _path, const string& _product,
+                const ptime& _start, const ptime& _end) {
+    MappedFile _file(_path);
+    LineSource _lines(_file);
+    string_view _fields[8];
+    size_t _found = 0;
+    int _count;
+    while ((_count = _lines.GetFields(_fields, 8)) >= 0) {
+        if (_count < 2 || _fields[1] != _product) {
+            continue;
+        }
+        ptime _time = boost::posix_time::time_from_string(string(_fields[0]));
+        if (_time >= _start && _time <= _end) {
+            _found++;
+        }
+    }
+    return _found;
+}
+
+// Time a query and print its latency
+void Measure(const string& _name, function<size_t()> _query) {
+    auto _begin = chrono::steady_clock::now();
+    size_t _found = _query();
+    chrono::duration<double> _elapsed = chrono::steady_clock::now() - _begin;
+    cout << _name << ": " << _elapsed.count() * 1e3 << " ms, " << _found
+         << " records" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t _count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    string _directory = argc > 2 ? argv[2] : ".";
+    string _text = _directory + "/historicalquery_bench.txt";
+    string _columnar = _directory + "/historicalquery_bench.col";
+    remove(_text.c_str());
+    remove(_columnar.c_str());
+    remove(GetColumnarIndexPath(_columnar).c_str());
+    WriteFiles(_count, _text, _columnar);
+    cout << "Records: " << _count << endl;
+
+    string _product = GetProductRegistry<Bond>().Get(3).GetProductId();
+    ptime _start = FromMicroseconds(BENCH_START + _count / 2 * BENCH_STEP);
+    ptime _end = FromMicroseconds(BENCH_START +
+                                  (_count / 2 + _count / 100) * BENCH_STEP);
+
+    Measure("text scan", [&]() {
+        return ScanText(_text, _product, _start, _end);
+    });
+    Measure("columnar index query", [&]() {
+        HistoricalQuery<Position<Bond>> _query(_columnar);
+        size_t _found = _query.Query(_product, _start, _end).size();
+        cout << "blocks decoded: " << _query.GetBlocksRead() << endl;
+        return _found;
+    });
+    // a query held open, as HistoricalDataService keeps one, only checks the
+    // file for new blocks
+    HistoricalQuery<Position<Bond>> _mapped(_columnar);
+    Measure("columnar index query, mapped once", [&]() {
+        _mapped.Refresh();
+        return _mapped.Query(_product, _start, _end).size();
+    });
+
+    remove(_text.c_str());
+    remove(_columnar.c_str());
+    remove(GetColumnarIndexPath(_columnar).c_str());
+    return 0;
+}
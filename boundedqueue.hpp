@@ -0,0 +1,222 @@
+/**
+ * boundedqueue.hpp
+ * Defines a bounded queue with a policy for values arriving while it is full.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include "spscring.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/**
+ * What a bounded queue does with a value arriving while it is full.
+ * BLOCK waits for room, so nothing is lost; DROP_OLDEST drops the oldest
+ * value queued; CONFLATE_BY_KEY replaces the latest value queued for the
+ * same key, or drops the oldest value if none is queued for the key. Below
+ * capacity every policy queues the value as it is.
+ */
+enum OverflowPolicy { BLOCK, DROP_OLDEST, CONFLATE_BY_KEY };
+
+// Get the overflow policy of a name: block, drop-oldest or conflate
+bool ParseOverflowPolicy(const string& _name, OverflowPolicy& _policy) {
+    if (_name == "block") {
+        _policy = BLOCK;
+    } else if (_name == "drop-oldest") {
+        _policy = DROP_OLDEST;
+    } else if (_name == "conflate") {
+        _policy = CONFLATE_BY_KEY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Get the conflation key of a value: the index of its product
+template <typename V> size_t GetProductKey(const V& _data) {
+    return _data.GetProductHandle().GetIndex();
+}
+
+// Get the conflation key of an execution order: its order id
+template <typename V> string GetOrderKey(const V& _data) {
+    return _data.GetOrderId();
+}
+
+// Get the conflation key of an inquiry: its inquiry id
+template <typename V> string GetInquiryKey(const V& _data) {
+    return _data.GetInquiryId();
+}
+
+/**
+ * Bounded queue from a single producer thread to a single consumer thread.
+ * Blocking queues pass values through a lock-free ring; the others drop
+ * values from a deque under a lock, since the producer then takes values off
+ * the consumer's end as well. Values dropped, including those replaced by
+ * conflation, are counted. Values conflate only when their keys are equal,
+ * so a key must identify the value exactly, not just hash it.
+ * Type V is the value type, which must be default constructible, and type K
+ * the type of its conflation key.
+ */
+template <typename V, typename K = size_t> class BoundedQueue {
+
+  public:
+    // ctor for a queue holding at least _capacity values, conflating values
+    // on _key when the policy is CONFLATE_BY_KEY
+    BoundedQueue(size_t _capacity, OverflowPolicy _policy,
+                 function<K(const V&)> _key = nullptr);
+
+    // Queue a value, applying the overflow policy while the queue is full
+    void Push(const V& _data);
+
+    // Move up to _max of the oldest values to the end of _batch, returning
+    // the number moved
+    size_t PopBatch(vector<V>& _batch, size_t _max);
+
+    // Get the number of values queued
+    size_t GetDepth() const;
+
+    // Get the number of values dropped so far
+    uint64_t GetDropped() const;
+
+    // Get the overflow policy
+    OverflowPolicy GetPolicy() const;
+
+  private:
+    // Drop the oldest value, with the lock held
+    void DropOldest();
+
+    // Forget the sequence of the front value's key if it is the latest
+    // queued for the key, with the lock held
+    void ForgetFront();
+
+    OverflowPolicy policy;
+    function<K(const V&)> key;
+    size_t capacity;
+    atomic<uint64_t> dropped;
+
+    // blocking queues only
+    SpscRing<V> ring;
+
+    // dropping queues only, under the lock
+    mutable mutex lock;
+    deque<V> values;
+    // sequence of the front value, and of the latest value queued for each
+    // key
+    uint64_t front;
+    unordered_map<K, uint64_t> sequences;
+};
+
+template <typename V, typename K>
+BoundedQueue<V, K>::BoundedQueue(size_t _capacity, OverflowPolicy _policy,
+                                 function<K(const V&)> _key)
+    : policy(_policy), key(_key), capacity(_capacity), dropped(0),
+      ring(_policy == BLOCK ? _capacity : 1), front(0) {
+    if (policy == CONFLATE_BY_KEY && !key) {
+        cerr << "Error: No conflation key, dropping the oldest value instead"
+             << endl;
+        policy = DROP_OLDEST;
+    }
+}
+
+template <typename V, typename K>
+void BoundedQueue<V, K>::Push(const V& _data) {
+    if (policy == BLOCK) {
+        while (!ring.TryPush(_data)) {
+            this_thread::yield();
+        }
+        return;
+    }
+
+    lock_guard<mutex> _lock(lock);
+    if (values.size() >= capacity) {
+        if (policy == CONFLATE_BY_KEY) {
+            auto _queued = sequences.find(key(_data));
+            if (_queued != sequences.end()) {
+                values[_queued->second - front] = _data;
+                dropped.fetch_add(1);
+                return;
+            }
+        }
+        DropOldest();
+    }
+    if (policy == CONFLATE_BY_KEY) {
+        sequences[key(_data)] = front + values.size();
+    }
+    values.push_back(_data);
+}
+
+template <typename V, typename K>
+size_t BoundedQueue<V, K>::PopBatch(vector<V>& _batch, size_t _max) {
+    size_t _moved = 0;
+    if (policy == BLOCK) {
+        V _data;
+        while (_moved < _max && ring.TryPop(_data)) {
+            _batch.push_back(move(_data));
+            _moved++;
+        }
+        return _moved;
+    }
+
+    lock_guard<mutex> _lock(lock);
+    while (_moved < _max && !values.empty()) {
+        if (policy == CONFLATE_BY_KEY) {
+            ForgetFront();
+        }
+        _batch.push_back(move(values.front()));
+        values.pop_front();
+        front++;
+        _moved++;
+    }
+    return _moved;
+}
+
+template <typename V, typename K>
+size_t BoundedQueue<V, K>::GetDepth() const {
+    if (policy == BLOCK) {
+        return ring.GetSize();
+    }
+    lock_guard<mutex> _lock(lock);
+    return values.size();
+}
+
+template <typename V, typename K>
+uint64_t BoundedQueue<V, K>::GetDropped() const {
+    return dropped.load();
+}
+
+template <typename V, typename K>
+OverflowPolicy BoundedQueue<V, K>::GetPolicy() const {
+    return policy;
+}
+
+template <typename V, typename K>
+void BoundedQueue<V, K>::DropOldest() {
+    if (policy == CONFLATE_BY_KEY) {
+        ForgetFront();
+    }
+    values.pop_front();
+    front++;
+    dropped.fetch_add(1);
+}
+
+template <typename V, typename K>
+void BoundedQueue<V, K>::ForgetFront() {
+    auto _queued = sequences.find(key(values.front()));
+    if (_queued != sequences.end() && _queued->second == front) {
+        sequences.erase(_queued);
+    }
+}
+
+#endif
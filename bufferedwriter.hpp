@@ -0,0 +1,353 @@
+/**
+ * bufferedwriter.hpp
+ * Defines a long-lived buffered writer appending records to an output file.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef BUFFERED_WRITER_HPP
+#define BUFFERED_WRITER_HPP
+
+#include "uringfile.hpp"
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <fcntl.h>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// Bytes buffered before they are written to the file
+constexpr size_t WRITER_BUFFER_SIZE = 1 << 20;
+
+// Time since the last write after which a commit or a flush timer writes
+// the buffer
+constexpr int WRITER_FLUSH_MILLISECONDS = 100;
+
+// Period of the flush timer, so buffered bytes wait at most about
+// WRITER_FLUSH_MILLISECONDS plus this
+constexpr int FLUSH_TIMER_MILLISECONDS = 25;
+
+/**
+ * How far a batch of records has got by the time the writer is done with it.
+ * BUFFERED leaves it in the buffer until the buffer fills, or until the time
+ * threshold has passed since the last write and the next commit or a flush
+ * timer writes it, so a crash may lose it; FLUSH writes it to the file,
+ * where it survives the process; SYNC waits for it to reach the disk, where
+ * it survives the machine.
+ */
+enum DurabilityPolicy { BUFFERED, FLUSH, SYNC };
+
+// Get the durability policy of a name: buffered, flush or sync
+bool ParseDurabilityPolicy(const string& _name, DurabilityPolicy& _policy) {
+    if (_name == "buffered") {
+        _policy = BUFFERED;
+    } else if (_name == "flush") {
+        _policy = FLUSH;
+    } else if (_name == "sync") {
+        _policy = SYNC;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * How a writer hands its buffer to the file. WRITE_BACKEND appends with
+ * write, waiting for each; URING_BACKEND queues it on io_uring and carries
+ * on, falling back to pwrite where io_uring is unavailable.
+ */
+enum WriterBackend { WRITE_BACKEND, URING_BACKEND };
+
+// Get the writer backend of a name: write or uring
+bool ParseWriterBackend(const string& _name, WriterBackend& _backend) {
+    if (_name == "write") {
+        _backend = WRITE_BACKEND;
+    } else if (_name == "uring") {
+        _backend = URING_BACKEND;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Writer appending to a file it holds open, through a buffer in user space.
+ * The file is opened on the first write, so nothing is created until there
+ * is something to write, and whatever is buffered is written when the writer
+ * goes. Only one thread may use a writer at a time.
+ */
+class BufferedWriter {
+
+  public:
+    // ctor for a writer appending to the file at the path
+    BufferedWriter(const string& _path,
+                   DurabilityPolicy _durability = BUFFERED);
+
+    // Write whatever is buffered, then close the file
+    ~BufferedWriter();
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    // Append bytes to the buffer, writing it first once it would overflow
+    void Append(const char* _data, size_t _size);
+    void Append(const string& _data);
+    void Append(char _data);
+
+    // End a batch of records, writing them as far as the durability policy
+    // asks, or as the time threshold does
+    void Commit();
+
+    // Write the buffer to the file, false on error. On io_uring a buffered
+    // writer leaves the write in flight.
+    bool Flush();
+
+    // Check whether the time threshold has passed since the last write
+    bool IsFlushDue() const;
+
+    // Write the buffer if it is not empty and the time threshold has
+    // passed, false on error
+    bool FlushIfDue();
+
+    // Write the buffer and wait for the file to reach the disk, false on
+    // error
+    bool Sync();
+
+    // Get the durability policy
+    DurabilityPolicy GetDurability() const;
+
+    // Set the durability policy
+    void SetDurability(DurabilityPolicy _durability);
+
+    // Set the backend, before the first write
+    void SetBackend(WriterBackend _backend);
+
+    // Get the path of the file
+    const string& GetPath() const;
+
+    // Set the path of the file, before the first write
+    void SetPath(const string& _path);
+
+  private:
+    // Open the file if it is not open yet, false on error
+    bool Open();
+
+    string path;
+    DurabilityPolicy durability;
+    WriterBackend backend;
+    int fd;
+    unique_ptr<UringFile> uring;
+    string buffer;
+    chrono::steady_clock::time_point lastFlush;
+};
+
+BufferedWriter::BufferedWriter(const string& _path,
+                               DurabilityPolicy _durability)
+    : path(_path), durability(_durability), backend(WRITE_BACKEND), fd(-1),
+      lastFlush(chrono::steady_clock::now()) {
+    buffer.reserve(WRITER_BUFFER_SIZE);
+}
+
+BufferedWriter::~BufferedWriter() {
+    if (durability == SYNC) {
+        Sync();
+    } else {
+        Flush();
+    }
+    // the ring goes first, waiting for its writes
+    uring.reset();
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void BufferedWriter::Append(const char* _data, size_t _size) {
+    if (buffer.size() + _size > WRITER_BUFFER_SIZE) {
+        Flush();
+    }
+    buffer.append(_data, _size);
+}
+
+void BufferedWriter::Append(const string& _data) {
+    Append(_data.data(), _data.size());
+}
+
+void BufferedWriter::Append(char _data) { Append(&_data, 1); }
+
+void BufferedWriter::Commit() {
+    if (durability == SYNC) {
+        Sync();
+    } else if (durability == FLUSH || IsFlushDue()) {
+        Flush();
+    }
+}
+
+bool BufferedWriter::Flush() {
+    lastFlush = chrono::steady_clock::now();
+    if (buffer.empty()) {
+        return true;
+    }
+    if (!Open()) {
+        buffer.clear();
+        return false;
+    }
+
+    if (uring) {
+        // the buffer is copied out, so it can be refilled at once; the
+        // writes are only waited for when the policy wants them in the file
+        bool _written = uring->Write(buffer.data(), buffer.size()) &&
+                        uring->Submit();
+        buffer.clear();
+        if (durability != BUFFERED) {
+            _written = uring->Wait() && _written;
+        }
+        return _written;
+    }
+
+    const char* _data = buffer.data();
+    size_t _left = buffer.size();
+    while (_left > 0) {
+        ssize_t _written = write(fd, _data, _left);
+        if (_written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            cerr << "Error: Unable to write file at " << path << endl;
+            buffer.clear();
+            return false;
+        }
+        _data += _written;
+        _left -= _written;
+    }
+    buffer.clear();
+    return true;
+}
+
+bool BufferedWriter::IsFlushDue() const {
+    return chrono::steady_clock::now() - lastFlush >=
+           chrono::milliseconds(WRITER_FLUSH_MILLISECONDS);
+}
+
+bool BufferedWriter::FlushIfDue() {
+    if (buffer.empty() || !IsFlushDue()) {
+        return true;
+    }
+    return Flush();
+}
+
+bool BufferedWriter::Sync() {
+    if (!Flush() || (uring && !uring->Wait())) {
+        return false;
+    }
+    if (fd >= 0 && fdatasync(fd) != 0) {
+        cerr << "Error: Unable to sync file at " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+DurabilityPolicy BufferedWriter::GetDurability() const { return durability; }
+
+void BufferedWriter::SetDurability(DurabilityPolicy _durability) {
+    durability = _durability;
+}
+
+void BufferedWriter::SetBackend(WriterBackend _backend) { backend = _backend; }
+
+const string& BufferedWriter::GetPath() const { return path; }
+
+void BufferedWriter::SetPath(const string& _path) { path = _path; }
+
+bool BufferedWriter::Open() {
+    if (fd >= 0) {
+        return true;
+    }
+    if (backend == URING_BACKEND) {
+        // writes in flight carry their offsets, from the end of the file
+        fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+    } else {
+        fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    }
+    if (fd < 0) {
+        cerr << "Error: Unable to open file at " << path << endl;
+        return false;
+    }
+    if (backend == URING_BACKEND) {
+        uring.reset(new UringFile(fd, lseek(fd, 0, SEEK_END)));
+    }
+    return true;
+}
+
+/**
+ * Thread flushing buffered writers on time. Every FLUSH_TIMER_MILLISECONDS
+ * it runs each flush added, which writes whatever has waited in a buffer
+ * past the time threshold, so the tail of a file does not wait for the next
+ * record to come along. A flush must take whatever lock its writer is used
+ * under.
+ */
+class FlushTimer {
+
+  public:
+    // ctor starting the thread
+    FlushTimer();
+
+    // Stop the thread
+    ~FlushTimer();
+
+    FlushTimer(const FlushTimer&) = delete;
+    FlushTimer& operator=(const FlushTimer&) = delete;
+
+    // Add a flush to run on every tick
+    void Add(function<void()> _flush);
+
+  private:
+    // Run the flushes on every tick until stopped
+    void Run();
+
+    mutex lock;
+    condition_variable wakeup;
+    vector<function<void()>> flushes;
+    bool stopping;
+    thread worker;
+};
+
+FlushTimer::FlushTimer() : stopping(false), worker(&FlushTimer::Run, this) {}
+
+FlushTimer::~FlushTimer() {
+    {
+        lock_guard<mutex> _lock(lock);
+        stopping = true;
+    }
+    wakeup.notify_one();
+    worker.join();
+}
+
+void FlushTimer::Add(function<void()> _flush) {
+    lock_guard<mutex> _lock(lock);
+    flushes.push_back(move(_flush));
+}
+
+void FlushTimer::Run() {
+    vector<function<void()>> _flushes;
+    unique_lock<mutex> _lock(lock);
+    while (!wakeup.wait_for(_lock,
+                            chrono::milliseconds(FLUSH_TIMER_MILLISECONDS),
+                            [this]() { return stopping; })) {
+        // the flushes run outside the lock, so adding one never waits on I/O
+        _flushes = flushes;
+        _lock.unlock();
+        for (auto& f : _flushes) {
+            f();
+        }
+        _lock.lock();
+    }
+}
+
+#endif
@@ -0,0 +1,1146 @@
+/**
+ * columnarstore.hpp
+ * Defines a binary, block-structured columnar format for historical data,
+ * with a writer per record type and a reader scanning single columns.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef COLUMNAR_STORE_HPP
+#define COLUMNAR_STORE_HPP
+
+#include "bufferedwriter.hpp"
+#include "execution.hpp"
+#include "inquiryservice.hpp"
+#include "mappedfile.hpp"
+#include "positionservice.hpp"
+#include "riskservice.hpp"
+#include "streaming.hpp"
+#include "utility.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Rows gathered into a block before it is written
+constexpr size_t COLUMNAR_BLOCK_ROWS = 4096;
+
+// Bytes opening a columnar file, and each block in it
+constexpr char COLUMNAR_FILE_MAGIC[8] = {'M', 'T', 'H', 'C',
+                                         'O', 'L', '0', '1'};
+constexpr uint32_t COLUMNAR_BLOCK_MAGIC = 0x4B4C4243;
+
+// Bytes opening the index of a columnar file
+constexpr char COLUMNAR_INDEX_MAGIC[8] = {'M', 'T', 'H', 'I',
+                                          'D', 'X', '0', '1'};
+
+/**
+ * How the values of a column are stored. Integers are zigzag varints.
+ * TIMESTAMP_DELTA holds microseconds since the epoch and PRICE_TICKS holds
+ * prices in 1/256 ticks, both as the difference from the value before them
+ * in the block; VARINT holds them as they are, FLOAT64 holds raw doubles.
+ * DICTIONARY holds each distinct string of the block once, followed by a
+ * code per value; PLAIN_STRING holds each value, prefixed by its length.
+ */
+enum ColumnEncoding : uint8_t {
+    TIMESTAMP_DELTA,
+    PRICE_TICKS,
+    VARINT,
+    FLOAT64,
+    DICTIONARY,
+    PLAIN_STRING
+};
+
+// The name and encoding of a column
+struct ColumnSpec {
+    string name;
+    ColumnEncoding encoding;
+};
+
+// Append an unsigned integer as a varint of 7 bits a byte
+void PutVarint(string& _out, uint64_t _value) {
+    while (_value >= 0x80) {
+        _out.push_back(static_cast<char>(_value | 0x80));
+        _value >>= 7;
+    }
+    _out.push_back(static_cast<char>(_value));
+}
+
+// Read a varint, false if it runs past the end
+bool GetVarint(const char*& _p, const char* _end, uint64_t& _value) {
+    _value = 0;
+    for (int _shift = 0; _p < _end && _shift < 64; _shift += 7) {
+        uint8_t _byte = static_cast<uint8_t>(*_p++);
+        _value |= static_cast<uint64_t>(_byte & 0x7F) << _shift;
+        if (!(_byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Append an integer as its raw bytes
+template <typename I> void PutFixed(string& _out, I _value) {
+    _out.append(reinterpret_cast<const char*>(&_value), sizeof(_value));
+}
+
+// Read an integer from its raw bytes, false if it runs past the end
+template <typename I>
+bool GetFixed(const char*& _p, const char* _end, I& _value) {
+    if (_end - _p < static_cast<ptrdiff_t>(sizeof(_value))) {
+        return false;
+    }
+    memcpy(&_value, _p, sizeof(_value));
+    _p += sizeof(_value);
+    return true;
+}
+
+// Map signed integers to unsigned ones, small magnitudes to small values
+uint64_t ZigZag(int64_t _value) {
+    return (static_cast<uint64_t>(_value) << 1) ^
+           static_cast<uint64_t>(_value >> 63);
+}
+
+int64_t UnZigZag(uint64_t _value) {
+    return static_cast<int64_t>(_value >> 1) ^
+           -static_cast<int64_t>(_value & 1);
+}
+
+// The time stamps of columnar files count microseconds from this time
+const ptime COLUMNAR_EPOCH(boost::gregorian::date(1970, 1, 1));
+
+// Get the microseconds since the epoch of a time
+int64_t ToMicroseconds(const ptime& _time) {
+    return (_time - COLUMNAR_EPOCH).total_microseconds();
+}
+
+// Get the time of microseconds since the epoch
+ptime FromMicroseconds(int64_t _microseconds) {
+    return COLUMNAR_EPOCH + boost::posix_time::microseconds(_microseconds);
+}
+
+// Get the path of the index kept alongside a columnar file
+string GetColumnarIndexPath(const string& _path) { return _path + ".idx"; }
+
+// Get the local time in microseconds since the epoch, as the text files
+// stamp their records
+int64_t GetLocalMicroseconds() {
+    return ToMicroseconds(microsec_clock::local_time());
+}
+
+/**
+ * The values of one column within the block being built.
+ */
+class ColumnBuilder {
+
+  public:
+    // ctor for a column of the given encoding
+    ColumnBuilder(ColumnEncoding _encoding);
+
+    // Add a value to a TIMESTAMP_DELTA, PRICE_TICKS or VARINT column
+    void AddInteger(int64_t _value);
+
+    // Add a value to a FLOAT64 column
+    void AddDouble(double _value);
+
+    // Add a value to a DICTIONARY or PLAIN_STRING column
+    void AddString(const string& _value);
+
+    // Append the encoded values to _out
+    void Encode(string& _out) const;
+
+    // Get the distinct strings of a DICTIONARY column, in order of code
+    const vector<string>& GetDictionary() const;
+
+    // Drop the values, starting a new block
+    void Reset();
+
+  private:
+    ColumnEncoding encoding;
+    string values;
+    int64_t previous;
+    unordered_map<string, uint32_t> codes;
+    vector<string> dictionary;
+};
+
+ColumnBuilder::ColumnBuilder(ColumnEncoding _encoding)
+    : encoding(_encoding), previous(0) {}
+
+void ColumnBuilder::AddInteger(int64_t _value) {
+    if (encoding == VARINT) {
+        PutVarint(values, ZigZag(_value));
+    } else {
+        PutVarint(values, ZigZag(_value - previous));
+        previous = _value;
+    }
+}
+
+void ColumnBuilder::AddDouble(double _value) { PutFixed(values, _value); }
+
+void ColumnBuilder::AddString(const string& _value) {
+    if (encoding == PLAIN_STRING) {
+        PutVarint(values, _value.size());
+        values.append(_value);
+        return;
+    }
+    auto _code = codes.find(_value);
+    if (_code == codes.end()) {
+        _code = codes.emplace(_value, dictionary.size()).first;
+        dictionary.push_back(_value);
+    }
+    PutVarint(values, _code->second);
+}
+
+void ColumnBuilder::Encode(string& _out) const {
+    if (encoding == DICTIONARY) {
+        PutVarint(_out, dictionary.size());
+        for (auto& s : dictionary) {
+            PutVarint(_out, s.size());
+            _out.append(s);
+        }
+    }
+    _out.append(values);
+}
+
+const vector<string>& ColumnBuilder::GetDictionary() const {
+    return dictionary;
+}
+
+void ColumnBuilder::Reset() {
+    values.clear();
+    previous = 0;
+    codes.clear();
+    dictionary.clear();
+}
+
+/**
+ * Cursor decoding the values of one column of a block in order.
+ */
+class ColumnCursor {
+
+  public:
+    // ctor for a cursor over no values
+    ColumnCursor();
+
+    // ctor for a cursor over the encoded values of a column of a block
+    ColumnCursor(ColumnEncoding _encoding, const char* _data, size_t _size);
+
+    // Get the next value of a TIMESTAMP_DELTA, PRICE_TICKS or VARINT column,
+    // false when none are left
+    bool GetInteger(int64_t& _value);
+
+    // Get the next value of a numeric column, prices in points, false when
+    // none are left
+    bool GetDouble(double& _value);
+
+    // Get the next value of a DICTIONARY or PLAIN_STRING column, false when
+    // none are left
+    bool GetString(string& _value);
+
+    // Get the distinct strings of a DICTIONARY column, in order of code
+    const vector<string>& GetDictionary() const;
+
+  private:
+    ColumnEncoding encoding;
+    const char* current;
+    const char* end;
+    int64_t previous;
+    vector<string> dictionary;
+};
+
+ColumnCursor::ColumnCursor()
+    : encoding(VARINT), current(nullptr), end(nullptr), previous(0) {}
+
+ColumnCursor::ColumnCursor(ColumnEncoding _encoding, const char* _data,
+                           size_t _size)
+    : encoding(_encoding), current(_data), end(_data + _size), previous(0) {
+    if (encoding != DICTIONARY) {
+        return;
+    }
+    uint64_t _count;
+    uint64_t _length;
+    if (!GetVarint(current, end, _count)) {
+        return;
+    }
+    for (uint64_t i = 0; i < _count && GetVarint(current, end, _length) &&
+                         _length <= static_cast<uint64_t>(end - current);
+         i++) {
+        dictionary.emplace_back(current, _length);
+        current += _length;
+    }
+}
+
+bool ColumnCursor::GetInteger(int64_t& _value) {
+    uint64_t _encoded;
+    if (!GetVarint(current, end, _encoded)) {
+        return false;
+    }
+    _value = UnZigZag(_encoded);
+    if (encoding != VARINT) {
+        _value += previous;
+        previous = _value;
+    }
+    return true;
+}
+
+bool ColumnCursor::GetDouble(double& _value) {
+    if (encoding == FLOAT64) {
+        return GetFixed(current, end, _value);
+    }
+    int64_t _integer;
+    if (!GetInteger(_integer)) {
+        return false;
+    }
+    _value = encoding == PRICE_TICKS ? _integer / double(TICKS_PER_POINT)
+                                     : double(_integer);
+    return true;
+}
+
+bool ColumnCursor::GetString(string& _value) {
+    uint64_t _length;
+    if (!GetVarint(current, end, _length)) {
+        return false;
+    }
+    if (encoding == DICTIONARY) {
+        if (_length >= dictionary.size()) {
+            return false;
+        }
+        _value = dictionary[_length];
+        return true;
+    }
+    if (_length > static_cast<uint64_t>(end - current)) {
+        return false;
+    }
+    _value.assign(current, _length);
+    current += _length;
+    return true;
+}
+
+const vector<string>& ColumnCursor::GetDictionary() const {
+    return dictionary;
+}
+
+/**
+ * The columns a record type is stored as, after the time column every
+ * record has. Specialized for each type persisted: AddRow adds a record to
+ * the columns being built, and ReadRow takes one back off column cursors.
+ * Type V is the data type.
+ */
+template <typename V> struct ColumnarSchema;
+
+template <typename T> struct ColumnarSchema<Position<T>> {
+    // each row has a count of books, and as many book and quantity values
+    static vector<ColumnSpec> GetColumns() {
+        return {{"product", DICTIONARY},
+                {"books", VARINT},
+                {"book", DICTIONARY},
+                {"quantity", VARINT}};
+    }
+
+    static void AddRow(Position<T>& _data, vector<ColumnBuilder>& _columns) {
+        map<string, long> _positions = _data.GetPositions();
+        _columns[0].AddString(_data.GetProduct().GetProductId());
+        _columns[1].AddInteger(_positions.size());
+        for (auto& p : _positions) {
+            _columns[2].AddString(p.first);
+            _columns[3].AddInteger(p.second);
+        }
+    }
+
+    static bool ReadRow(vector<ColumnCursor>& _columns, Position<T>& _data) {
+        string _product;
+        int64_t _books;
+        if (!_columns[0].GetString(_product) ||
+            !_columns[1].GetInteger(_books)) {
+            return false;
+        }
+        _data = Position<T>(GetProductRegistry<T>().At(_product));
+        for (int64_t i = 0; i < _books; i++) {
+            string _book;
+            int64_t _quantity;
+            if (!_columns[2].GetString(_book) ||
+                !_columns[3].GetInteger(_quantity)) {
+                return false;
+            }
+            _data.AddPosition(_book, _quantity);
+        }
+        return true;
+    }
+};
+
+template <typename T> struct ColumnarSchema<PV01<T>> {
+    static vector<ColumnSpec> GetColumns() {
+        return {{"product", DICTIONARY},
+                {"pv01", FLOAT64},
+                {"quantity", VARINT}};
+    }
+
+    static void AddRow(PV01<T>& _data, vector<ColumnBuilder>& _columns) {
+        _columns[0].AddString(_data.GetProduct().GetProductId());
+        _columns[1].AddDouble(_data.GetPV01());
+        _columns[2].AddInteger(_data.GetQuantity());
+    }
+
+    static bool ReadRow(vector<ColumnCursor>& _columns, PV01<T>& _data) {
+        string _product;
+        double _pv01;
+        int64_t _quantity;
+        if (!_columns[0].GetString(_product) ||
+            !_columns[1].GetDouble(_pv01) ||
+            !_columns[2].GetInteger(_quantity)) {
+            return false;
+        }
+        _data = PV01<T>(GetProductRegistry<T>().At(_product), _pv01, _quantity);
+        return true;
+    }
+};
+
+template <typename T> struct ColumnarSchema<ExecutionOrder<T>> {
+    static vector<ColumnSpec> GetColumns() {
+        return {{"product", DICTIONARY},
+                {"side", VARINT},
+                {"orderId", PLAIN_STRING},
+                {"orderType", VARINT},
+                {"price", PRICE_TICKS},
+                {"visibleQuantity", VARINT},
+                {"hiddenQuantity", VARINT},
+                {"parentOrderId", DICTIONARY},
+                {"isChildOrder", VARINT}};
+    }
+
+    static void AddRow(ExecutionOrder<T>& _data,
+                       vector<ColumnBuilder>& _columns) {
+        _columns[0].AddString(_data.GetProduct().GetProductId());
+        _columns[1].AddInteger(_data.GetPricingSide());
+        _columns[2].AddString(_data.GetOrderId());
+        _columns[3].AddInteger(_data.GetOrderType());
+        _columns[4].AddInteger(_data.GetPrice().GetTicks());
+        _columns[5].AddInteger(_data.GetVisibleQuantity());
+        _columns[6].AddInteger(_data.GetHiddenQuantity());
+        _columns[7].AddString(_data.GetParentOrderId());
+        _columns[8].AddInteger(_data.IsChildOrder());
+    }
+
+    static bool ReadRow(vector<ColumnCursor>& _columns,
+                        ExecutionOrder<T>& _data) {
+        string _product;
+        string _orderId;
+        string _parentOrderId;
+        int64_t _side, _orderType, _price, _visible, _hidden, _isChild;
+        if (!_columns[0].GetString(_product) ||
+            !_columns[1].GetInteger(_side) ||
+            !_columns[2].GetString(_orderId) ||
+            !_columns[3].GetInteger(_orderType) ||
+            !_columns[4].GetInteger(_price) ||
+            !_columns[5].GetInteger(_visible) ||
+            !_columns[6].GetInteger(_hidden) ||
+            !_columns[7].GetString(_parentOrderId) ||
+            !_columns[8].GetInteger(_isChild)) {
+            return false;
+        }
+        _data = ExecutionOrder<T>(
+            GetProductRegistry<T>().At(_product),
+            static_cast<PricingSide>(_side), _orderId,
+            static_cast<OrderType>(_orderType), TickPrice(_price), _visible,
+            _hidden, _parentOrderId, _isChild != 0);
+        return true;
+    }
+};
+
+template <typename T> struct ColumnarSchema<PriceStream<T>> {
+    static vector<ColumnSpec> GetColumns() {
+        return {{"product", DICTIONARY},
+                {"bidPrice", PRICE_TICKS},
+                {"bidVisibleQuantity", VARINT},
+                {"bidHiddenQuantity", VARINT},
+                {"offerPrice", PRICE_TICKS},
+                {"offerVisibleQuantity", VARINT},
+                {"offerHiddenQuantity", VARINT}};
+    }
+
+    static void AddRow(PriceStream<T>& _data,
+                       vector<ColumnBuilder>& _columns) {
+        const PriceStreamOrder& _bid = _data.GetBidOrder();
+        const PriceStreamOrder& _offer = _data.GetOfferOrder();
+        _columns[0].AddString(_data.GetProduct().GetProductId());
+        _columns[1].AddInteger(_bid.GetPrice().GetTicks());
+        _columns[2].AddInteger(_bid.GetVisibleQuantity());
+        _columns[3].AddInteger(_bid.GetHiddenQuantity());
+        _columns[4].AddInteger(_offer.GetPrice().GetTicks());
+        _columns[5].AddInteger(_offer.GetVisibleQuantity());
+        _columns[6].AddInteger(_offer.GetHiddenQuantity());
+    }
+
+    static bool ReadRow(vector<ColumnCursor>& _columns, PriceStream<T>& _data) {
+        string _product;
+        int64_t _values[6];
+        if (!_columns[0].GetString(_product)) {
+            return false;
+        }
+        for (int i = 0; i < 6; i++) {
+            if (!_columns[i + 1].GetInteger(_values[i])) {
+                return false;
+            }
+        }
+        PriceStreamOrder _bid(TickPrice(_values[0]), _values[1], _values[2],
+                              BID);
+        PriceStreamOrder _offer(TickPrice(_values[3]), _values[4],
+                                _values[5], OFFER);
+        _data =
+            PriceStream<T>(GetProductRegistry<T>().At(_product), _bid, _offer);
+        return true;
+    }
+};
+
+template <typename T> struct ColumnarSchema<Inquiry<T>> {
+    static vector<ColumnSpec> GetColumns() {
+        return {{"inquiryId", PLAIN_STRING},
+                {"product", DICTIONARY},
+                {"side", VARINT},
+                {"quantity", VARINT},
+                {"price", PRICE_TICKS},
+                {"state", VARINT}};
+    }
+
+    static void AddRow(Inquiry<T>& _data, vector<ColumnBuilder>& _columns) {
+        _columns[0].AddString(_data.GetInquiryId());
+        _columns[1].AddString(_data.GetProduct().GetProductId());
+        _columns[2].AddInteger(_data.GetSide());
+        _columns[3].AddInteger(_data.GetQuantity());
+        _columns[4].AddInteger(_data.GetPrice().GetTicks());
+        _columns[5].AddInteger(_data.GetState());
+    }
+
+    static bool ReadRow(vector<ColumnCursor>& _columns, Inquiry<T>& _data) {
+        string _inquiryId;
+        string _product;
+        int64_t _side, _quantity, _price, _state;
+        if (!_columns[0].GetString(_inquiryId) ||
+            !_columns[1].GetString(_product) ||
+            !_columns[2].GetInteger(_side) ||
+            !_columns[3].GetInteger(_quantity) ||
+            !_columns[4].GetInteger(_price) ||
+            !_columns[5].GetInteger(_state)) {
+            return false;
+        }
+        _data = Inquiry<T>(_inquiryId, GetProductRegistry<T>().At(_product),
+                           static_cast<Side>(_side), _quantity,
+                           TickPrice(_price),
+                           static_cast<InquiryState>(_state));
+        return true;
+    }
+};
+
+/**
+ * Writer of records to a columnar file, through a buffered writer.
+ * A file opens with its magic and schema: the number of columns, then the
+ * encoding and length-prefixed name of each. Blocks follow, each opening
+ * with its magic, row count and the byte length of each column, so a reader
+ * can skip to any column, followed by the columns. Every block is complete
+ * in itself, dictionaries and deltas included.
+ * Alongside the file the writer keeps a sparse index of its blocks, at the
+ * path of the file with .idx appended. After its magic the index holds an
+ * entry per block: the offset of the block in the file, its row count, its
+ * earliest and latest time stamps, and the length-prefixed ids of the
+ * products in it. The index is committed after the blocks it points to.
+ * Rows are gathered until a block is full, or until the end of each batch
+ * unless the writer is buffered, in which case they wait for the time
+ * threshold of the buffered writer, and whatever is left is written when
+ * the writer goes. Only one thread may use a writer at a time.
+ * Type V is the data type.
+ */
+template <typename V> class ColumnarWriter {
+
+  public:
+    // ctor for a writer of records through the buffered writer
+    ColumnarWriter(BufferedWriter& _writer);
+
+    // Write the rows gathered
+    ~ColumnarWriter();
+
+    // Add a record, stamped with the time it was persisted
+    void Add(V& _data, int64_t _time);
+
+    // End a batch of records, writing a block as the durability policy of
+    // the buffered writer asks
+    void Commit();
+
+    // Write the rows gathered and the buffers if the time threshold of the
+    // buffered writer has passed
+    void FlushIfDue();
+
+  private:
+    // Write the rows gathered as a block, and its index entry
+    void WriteBlock();
+
+    BufferedWriter& writer;
+    BufferedWriter index;
+    vector<ColumnSpec> specs;
+    ColumnBuilder time;
+    vector<ColumnBuilder> columns;
+    int productColumn;
+    size_t rows;
+    int64_t minTime;
+    int64_t maxTime;
+    bool headerChecked;
+    // offset in the file of the next block
+    uint64_t offset;
+    string block;
+    string entry;
+};
+
+template <typename V>
+ColumnarWriter<V>::ColumnarWriter(BufferedWriter& _writer)
+    : writer(_writer),
+      index(GetColumnarIndexPath(_writer.GetPath()), _writer.GetDurability()),
+      specs(ColumnarSchema<V>::GetColumns()), time(TIMESTAMP_DELTA),
+      productColumn(-1), rows(0), minTime(0), maxTime(0),
+      headerChecked(false), offset(0) {
+    for (size_t i = 0; i < specs.size(); i++) {
+        columns.emplace_back(specs[i].encoding);
+        if (specs[i].name == "product") {
+            productColumn = static_cast<int>(i);
+        }
+    }
+}
+
+template <typename V> ColumnarWriter<V>::~ColumnarWriter() {
+    WriteBlock();
+}
+
+template <typename V> void ColumnarWriter<V>::Add(V& _data, int64_t _time) {
+    time.AddInteger(_time);
+    minTime = rows == 0 || _time < minTime ? _time : minTime;
+    maxTime = rows == 0 || _time > maxTime ? _time : maxTime;
+    ColumnarSchema<V>::AddRow(_data, columns);
+    rows++;
+    if (rows >= COLUMNAR_BLOCK_ROWS) {
+        WriteBlock();
+    }
+}
+
+template <typename V> void ColumnarWriter<V>::Commit() {
+    if (writer.GetDurability() != BUFFERED || writer.IsFlushDue()) {
+        WriteBlock();
+    }
+    writer.Commit();
+    index.SetDurability(writer.GetDurability());
+    index.Commit();
+}
+
+template <typename V> void ColumnarWriter<V>::FlushIfDue() {
+    if (rows > 0 && writer.IsFlushDue()) {
+        WriteBlock();
+    }
+    writer.FlushIfDue();
+    index.FlushIfDue();
+}
+
+template <typename V> void ColumnarWriter<V>::WriteBlock() {
+    if (rows == 0) {
+        return;
+    }
+
+    block.clear();
+    // a new file opens with the schema and starts a new index; an existing
+    // one already has both, and blocks go on from its end
+    if (!headerChecked) {
+        struct stat _stat;
+        string _indexPath = GetColumnarIndexPath(writer.GetPath());
+        if (stat(writer.GetPath().c_str(), &_stat) != 0 || _stat.st_size == 0) {
+            remove(_indexPath.c_str());
+            block.append(COLUMNAR_FILE_MAGIC, sizeof(COLUMNAR_FILE_MAGIC));
+            PutVarint(block, specs.size() + 1);
+            block.push_back(static_cast<char>(TIMESTAMP_DELTA));
+            PutVarint(block, 4);
+            block.append("time");
+            for (auto& s : specs) {
+                block.push_back(static_cast<char>(s.encoding));
+                PutVarint(block, s.name.size());
+                block.append(s.name);
+            }
+        } else {
+            offset = _stat.st_size;
+        }
+        if (stat(_indexPath.c_str(), &_stat) != 0 || _stat.st_size == 0) {
+            entry.append(COLUMNAR_INDEX_MAGIC, sizeof(COLUMNAR_INDEX_MAGIC));
+        }
+        headerChecked = true;
+    }
+
+    vector<string> _encoded(columns.size() + 1);
+    time.Encode(_encoded[0]);
+    for (size_t i = 0; i < columns.size(); i++) {
+        columns[i].Encode(_encoded[i + 1]);
+    }
+
+    PutFixed(entry, static_cast<uint64_t>(offset + block.size()));
+    PutFixed(entry, static_cast<uint32_t>(rows));
+    PutFixed(entry, minTime);
+    PutFixed(entry, maxTime);
+    if (productColumn < 0) {
+        PutVarint(entry, 0);
+    } else {
+        const vector<string>& _products =
+            columns[productColumn].GetDictionary();
+        PutVarint(entry, _products.size());
+        for (auto& p : _products) {
+            PutVarint(entry, p.size());
+            entry.append(p);
+        }
+    }
+
+    PutFixed(block, COLUMNAR_BLOCK_MAGIC);
+    PutFixed(block, static_cast<uint32_t>(rows));
+    for (auto& e : _encoded) {
+        PutFixed(block, static_cast<uint32_t>(e.size()));
+    }
+    for (auto& e : _encoded) {
+        block.append(e);
+    }
+    writer.Append(block);
+    offset += block.size();
+    index.Append(entry);
+    entry.clear();
+
+    time.Reset();
+    for (auto& c : columns) {
+        c.Reset();
+    }
+    rows = 0;
+}
+
+/**
+ * Reader of a columnar file, mapped into memory. Opening it reads the schema
+ * and takes the blocks, with their time ranges and products, from the index
+ * kept alongside the file. Blocks the index does not cover yet, such as
+ * those written after it was last committed, are found by walking the file
+ * and summarized from their time and product columns. A scan decodes one
+ * column of every block and skips the others.
+ * Blocks are taken to be in time order, as records are stamped when they are
+ * written. A reader can be refreshed to take in blocks appended since.
+ */
+class ColumnarReader {
+
+  public:
+    // ctor for a reader of the file at the path
+    ColumnarReader(const string& _path);
+
+    // Check whether the file was read as a columnar file
+    bool IsValid() const;
+
+    // Map the file again if it has grown, and walk the blocks appended to it
+    // since it was last read. Returns true if it was refreshed.
+    bool Refresh();
+
+    // Get the columns of the file, the time column first
+    const vector<ColumnSpec>& GetColumns() const;
+
+    // Get the number of rows, summed over the blocks
+    size_t GetRowCount() const;
+
+    // Get the number of blocks
+    size_t GetBlockCount() const;
+
+    // Get the number of blocks found through the index
+    size_t GetIndexedBlockCount() const;
+
+    // Get the blocks which may hold rows of a product stamped between two
+    // times, inclusive, by binary search on time. An empty product matches
+    // every product.
+    vector<size_t> FindBlocks(const string& _product, int64_t _start,
+                              int64_t _end) const;
+
+    // Get a cursor over one column of a block, false if there is no such
+    // block or column
+    bool GetCursor(size_t _block, size_t _column, ColumnCursor& _cursor) const;
+
+    // Scan a TIMESTAMP_DELTA, PRICE_TICKS or VARINT column, false if there
+    // is no such column
+    bool ScanIntegers(const string& _column, vector<int64_t>& _values) const;
+
+    // Scan a numeric column, prices in points, false if there is no such
+    // column
+    bool ScanDoubles(const string& _column, vector<double>& _values) const;
+
+    // Scan a DICTIONARY or PLAIN_STRING column, false if there is no such
+    // column
+    bool ScanStrings(const string& _column, vector<string>& _values) const;
+
+  private:
+    // The time range and products of a block, and the bytes of its columns
+    struct Block {
+        uint32_t rows;
+        int64_t minTime;
+        int64_t maxTime;
+        vector<string> products;
+        vector<const char*> columns;
+        vector<uint32_t> lengths;
+    };
+
+    // Map the file and read it from the start, reporting it if malformed
+    void Open();
+
+    // Read the schema and the blocks, false if the file is malformed
+    bool ReadFile(const string& _path);
+
+    // Walk and summarize the blocks from _p, moving _p past them. Stops at
+    // a block which cannot be read, such as one not yet wholly written.
+    void WalkBlocks(const char*& _p, const char* _end);
+
+    // Take the blocks from the index, as far as its entries follow each
+    // other from _p, moving _p past them
+    void ReadIndex(const string& _path, const char*& _p, const char* _end);
+
+    // Read the header of the block at _p and move past the block, false if
+    // it is malformed
+    bool ReadBlock(const char*& _p, const char* _end, Block& _block) const;
+
+    // Get the time range and products of a block from its columns
+    void Summarize(Block& _block) const;
+
+    // Get the position of a column, -1 if there is none
+    int FindColumn(const string& _column) const;
+
+    string path;
+    unique_ptr<MappedFile> file;
+    vector<ColumnSpec> columns;
+    vector<Block> blocks;
+    int productColumn;
+    size_t rowCount;
+    size_t indexedBlocks;
+    // bytes of the file read, up to the end of the last whole block
+    size_t readSize;
+    bool valid;
+};
+
+ColumnarReader::ColumnarReader(const string& _path)
+    : path(_path), productColumn(-1), rowCount(0), indexedBlocks(0),
+      readSize(0), valid(false) {
+    Open();
+}
+
+bool ColumnarReader::IsValid() const { return valid; }
+
+bool ColumnarReader::Refresh() {
+    struct stat _stat;
+    if (stat(path.c_str(), &_stat) != 0 ||
+        static_cast<size_t>(_stat.st_size) == file->GetSize()) {
+        return false;
+    }
+    if (!valid || static_cast<size_t>(_stat.st_size) < readSize) {
+        // nothing was read yet, such as a file without its header, or the
+        // file was written anew
+        Open();
+        return valid;
+    }
+
+    unique_ptr<MappedFile> _file(new MappedFile(path));
+    if (!_file->IsOpen()) {
+        return false;
+    }
+    // the blocks already read point into the old mapping
+    const char* _oldData = file->GetData();
+    for (auto& b : blocks) {
+        for (auto& c : b.columns) {
+            c = _file->GetData() + (c - _oldData);
+        }
+    }
+    file = move(_file);
+
+    const char* _p = file->GetData() + readSize;
+    size_t _known = blocks.size();
+    WalkBlocks(_p, file->GetData() + file->GetSize());
+    for (size_t b = _known; b < blocks.size(); b++) {
+        rowCount += blocks[b].rows;
+    }
+    return true;
+}
+
+void ColumnarReader::Open() {
+    file.reset(new MappedFile(path));
+    columns.clear();
+    blocks.clear();
+    productColumn = -1;
+    rowCount = 0;
+    indexedBlocks = 0;
+    readSize = 0;
+    valid = file->IsOpen() && ReadFile(path);
+    // an empty file has not had its header written yet
+    if (file->IsOpen() && file->GetSize() > 0 && !valid) {
+        cerr << "Error: Malformed columnar file at " << path << endl;
+    }
+}
+
+const vector<ColumnSpec>& ColumnarReader::GetColumns() const {
+    return columns;
+}
+
+size_t ColumnarReader::GetRowCount() const { return rowCount; }
+
+size_t ColumnarReader::GetBlockCount() const { return blocks.size(); }
+
+size_t ColumnarReader::GetIndexedBlockCount() const { return indexedBlocks; }
+
+vector<size_t> ColumnarReader::FindBlocks(const string& _product,
+                                          int64_t _start, int64_t _end) const {
+    auto _block = partition_point(
+        blocks.begin(), blocks.end(),
+        [&](const Block& b) { return b.maxTime < _start; });
+    vector<size_t> _found;
+    for (; _block != blocks.end() && _block->minTime <= _end; ++_block) {
+        if (_product.empty() || productColumn < 0 ||
+            find(_block->products.begin(), _block->products.end(),
+                 _product) != _block->products.end()) {
+            _found.push_back(_block - blocks.begin());
+        }
+    }
+    return _found;
+}
+
+bool ColumnarReader::GetCursor(size_t _block, size_t _column,
+                               ColumnCursor& _cursor) const {
+    if (_block >= blocks.size() || _column >= columns.size()) {
+        return false;
+    }
+    _cursor = ColumnCursor(columns[_column].encoding,
+                           blocks[_block].columns[_column],
+                           blocks[_block].lengths[_column]);
+    return true;
+}
+
+bool ColumnarReader::ScanIntegers(const string& _column,
+                                  vector<int64_t>& _values) const {
+    int _index = FindColumn(_column);
+    if (_index < 0) {
+        return false;
+    }
+    ColumnEncoding _encoding = columns[_index].encoding;
+    if (_encoding == FLOAT64 || _encoding == DICTIONARY ||
+        _encoding == PLAIN_STRING) {
+        return false;
+    }
+    for (size_t b = 0; b < blocks.size(); b++) {
+        ColumnCursor _cursor;
+        GetCursor(b, _index, _cursor);
+        int64_t _value;
+        while (_cursor.GetInteger(_value)) {
+            _values.push_back(_value);
+        }
+    }
+    return true;
+}
+
+bool ColumnarReader::ScanDoubles(const string& _column,
+                                 vector<double>& _values) const {
+    int _index = FindColumn(_column);
+    if (_index < 0) {
+        return false;
+    }
+    ColumnEncoding _encoding = columns[_index].encoding;
+    if (_encoding == DICTIONARY || _encoding == PLAIN_STRING) {
+        return false;
+    }
+    for (size_t b = 0; b < blocks.size(); b++) {
+        ColumnCursor _cursor;
+        GetCursor(b, _index, _cursor);
+        double _value;
+        while (_cursor.GetDouble(_value)) {
+            _values.push_back(_value);
+        }
+    }
+    return true;
+}
+
+bool ColumnarReader::ScanStrings(const string& _column,
+                                 vector<string>& _values) const {
+    int _index = FindColumn(_column);
+    if (_index < 0) {
+        return false;
+    }
+    ColumnEncoding _encoding = columns[_index].encoding;
+    if (_encoding != DICTIONARY && _encoding != PLAIN_STRING) {
+        return false;
+    }
+    for (size_t b = 0; b < blocks.size(); b++) {
+        ColumnCursor _cursor;
+        GetCursor(b, _index, _cursor);
+        string _value;
+        while (_cursor.GetString(_value)) {
+            _values.push_back(_value);
+        }
+    }
+    return true;
+}
+
+bool ColumnarReader::ReadFile(const string& _path) {
+    const char* _p = file->GetData();
+    const char* _end = _p + file->GetSize();
+    if (_end - _p < static_cast<ptrdiff_t>(sizeof(COLUMNAR_FILE_MAGIC)) ||
+        memcmp(_p, COLUMNAR_FILE_MAGIC, sizeof(COLUMNAR_FILE_MAGIC)) != 0) {
+        return false;
+    }
+    _p += sizeof(COLUMNAR_FILE_MAGIC);
+
+    uint64_t _count;
+    if (!GetVarint(_p, _end, _count)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < _count; i++) {
+        uint64_t _length;
+        if (_p == _end) {
+            return false;
+        }
+        ColumnEncoding _encoding = static_cast<ColumnEncoding>(*_p++);
+        if (!GetVarint(_p, _end, _length) ||
+            static_cast<uint64_t>(_end - _p) < _length) {
+            return false;
+        }
+        columns.push_back({string(_p, _length), _encoding});
+        _p += _length;
+    }
+    productColumn = FindColumn("product");
+
+    ReadIndex(_path, _p, _end);
+    indexedBlocks = blocks.size();
+    WalkBlocks(_p, _end);
+    // a malformed block, such as one cut short by a crash, ends the file
+    if (_p < _end) {
+        cerr << "Error: Malformed block in columnar file at " << _path
+             << endl;
+    }
+    for (auto& b : blocks) {
+        rowCount += b.rows;
+    }
+    return true;
+}
+
+void ColumnarReader::WalkBlocks(const char*& _p, const char* _end) {
+    while (_p < _end) {
+        const char* _next = _p;
+        Block _block;
+        if (!ReadBlock(_next, _end, _block)) {
+            break;
+        }
+        Summarize(_block);
+        blocks.push_back(move(_block));
+        _p = _next;
+    }
+    readSize = _p - file->GetData();
+}
+
+void ColumnarReader::ReadIndex(const string& _path, const char*& _p,
+                               const char* _end) {
+    // without an index the whole file is walked
+    struct stat _stat;
+    string _indexPath = GetColumnarIndexPath(_path);
+    if (stat(_indexPath.c_str(), &_stat) != 0) {
+        return;
+    }
+    MappedFile _index(_indexPath);
+    if (!_index.IsOpen()) {
+        return;
+    }
+    const char* _q = _index.GetData();
+    const char* _qEnd = _q + _index.GetSize();
+    if (_qEnd - _q < static_cast<ptrdiff_t>(sizeof(COLUMNAR_INDEX_MAGIC)) ||
+        memcmp(_q, COLUMNAR_INDEX_MAGIC, sizeof(COLUMNAR_INDEX_MAGIC)) != 0) {
+        return;
+    }
+    _q += sizeof(COLUMNAR_INDEX_MAGIC);
+
+    // an entry is only taken if its block is the next one in the file, so
+    // a stale or torn index leaves the rest of the file to be walked
+    while (_q < _qEnd) {
+        uint64_t _offset;
+        uint32_t _rows;
+        uint64_t _count;
+        Block _block;
+        if (!GetFixed(_q, _qEnd, _offset) || !GetFixed(_q, _qEnd, _rows) ||
+            !GetFixed(_q, _qEnd, _block.minTime) ||
+            !GetFixed(_q, _qEnd, _block.maxTime) ||
+            !GetVarint(_q, _qEnd, _count)) {
+            return;
+        }
+        for (uint64_t i = 0; i < _count; i++) {
+            uint64_t _length;
+            if (!GetVarint(_q, _qEnd, _length) ||
+                static_cast<uint64_t>(_qEnd - _q) < _length) {
+                return;
+            }
+            _block.products.emplace_back(_q, _length);
+            _q += _length;
+        }
+
+        const char* _next = _p;
+        if (_offset != static_cast<uint64_t>(_p - file->GetData()) ||
+            !ReadBlock(_next, _end, _block) || _block.rows != _rows) {
+            return;
+        }
+        blocks.push_back(move(_block));
+        _p = _next;
+    }
+}
+
+bool ColumnarReader::ReadBlock(const char*& _p, const char* _end,
+                               Block& _block) const {
+    uint32_t _magic;
+    if (!GetFixed(_p, _end, _magic) || _magic != COLUMNAR_BLOCK_MAGIC ||
+        !GetFixed(_p, _end, _block.rows)) {
+        return false;
+    }
+    _block.lengths.resize(columns.size());
+    for (auto& l : _block.lengths) {
+        if (!GetFixed(_p, _end, l)) {
+            return false;
+        }
+    }
+    _block.columns.clear();
+    for (auto& l : _block.lengths) {
+        if (static_cast<size_t>(_end - _p) < l) {
+            return false;
+        }
+        _block.columns.push_back(_p);
+        _p += l;
+    }
+    return true;
+}
+
+void ColumnarReader::Summarize(Block& _block) const {
+    ColumnCursor _time(columns[0].encoding, _block.columns[0],
+                       _block.lengths[0]);
+    int64_t _value;
+    bool _first = true;
+    while (_time.GetInteger(_value)) {
+        _block.minTime = _first || _value < _block.minTime ? _value
+                                                           : _block.minTime;
+        _block.maxTime = _first || _value > _block.maxTime ? _value
+                                                           : _block.maxTime;
+        _first = false;
+    }
+    if (_first) {
+        _block.minTime = _block.maxTime = 0;
+    }
+    if (productColumn >= 0 && columns[productColumn].encoding == DICTIONARY) {
+        ColumnCursor _products(DICTIONARY, _block.columns[productColumn],
+                               _block.lengths[productColumn]);
+        _block.products = _products.GetDictionary();
+    }
+}
+
+int ColumnarReader::FindColumn(const string& _column) const {
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (columns[i].name == _column) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+#endif
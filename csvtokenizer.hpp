@@ -0,0 +1,154 @@
+/**
+ * csvtokenizer.hpp
+ * Defines a vectorized scanner for the separators of comma separated input.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef CSV_TOKENIZER_HPP
+#define CSV_TOKENIZER_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSV_TOKENIZER_X86 1
+#endif
+
+using namespace std;
+
+// Flag set on the offset of a separator which is a newline
+constexpr uint32_t CSV_NEWLINE_FLAG = 0x80000000u;
+
+// Largest buffer TokenizeCsv accepts, offsets must stay clear of the flag
+constexpr size_t CSV_MAX_BUFFER = CSV_NEWLINE_FLAG - 1;
+
+// Bytes examined per step of the scanner
+constexpr int CSV_BLOCK_SIZE = 64;
+
+// Masks of the ',' and '\n' bytes of one 64-byte block, bit i for byte i
+typedef uint64_t (*CsvBlockScanner)(const char* _block, uint64_t& _newlines);
+
+uint64_t ScanCsvBlockScalar(const char* _block, uint64_t& _newlines) {
+    uint64_t _separators = 0;
+    _newlines = 0;
+    for (int i = 0; i < CSV_BLOCK_SIZE; i++) {
+        uint64_t _bit = uint64_t(1) << i;
+        if (_block[i] == '\n') {
+            _newlines |= _bit;
+            _separators |= _bit;
+        } else if (_block[i] == ',') {
+            _separators |= _bit;
+        }
+    }
+    return _separators;
+}
+
+#ifdef CSV_TOKENIZER_X86
+__attribute__((target("sse2"))) uint64_t
+ScanCsvBlockSSE2(const char* _block, uint64_t& _newlines) {
+    const __m128i _comma = _mm_set1_epi8(',');
+    const __m128i _newline = _mm_set1_epi8('\n');
+    uint64_t _commas = 0;
+    _newlines = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i _bytes = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(_block + i * 16));
+        uint64_t c = static_cast<uint16_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_bytes, _comma)));
+        uint64_t n = static_cast<uint16_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_bytes, _newline)));
+        _commas |= c << (i * 16);
+        _newlines |= n << (i * 16);
+    }
+    return _commas | _newlines;
+}
+
+__attribute__((target("avx2"))) uint64_t
+ScanCsvBlockAVX2(const char* _block, uint64_t& _newlines) {
+    const __m256i _comma = _mm256_set1_epi8(',');
+    const __m256i _newline = _mm256_set1_epi8('\n');
+    __m256i _low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_block));
+    __m256i _high =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_block + 32));
+    uint64_t _commas =
+        static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(_low, _comma))) |
+        static_cast<uint64_t>(static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(_high, _comma))))
+            << 32;
+    _newlines =
+        static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(_low, _newline))) |
+        static_cast<uint64_t>(static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(_high, _newline))))
+            << 32;
+    return _commas | _newlines;
+}
+#endif
+
+// Pick the widest scanner the running CPU supports
+CsvBlockScanner SelectCsvBlockScanner() {
+#ifdef CSV_TOKENIZER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return ScanCsvBlockAVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return ScanCsvBlockSSE2;
+    }
+#endif
+    return ScanCsvBlockScalar;
+}
+
+// Append to _separators the offset of every ',' and '\n' in the buffer, in
+// order, with CSV_NEWLINE_FLAG set on newlines. The buffer is scanned in
+// 64-byte blocks; the scanner can be forced, for instance for benchmarks.
+// Returns false if the buffer is larger than CSV_MAX_BUFFER.
+bool TokenizeCsv(const char* _begin, const char* _end,
+                 vector<uint32_t>& _separators,
+                 CsvBlockScanner _scanner = nullptr) {
+    static const CsvBlockScanner _best = SelectCsvBlockScanner();
+    if (_scanner == nullptr) {
+        _scanner = _best;
+    }
+
+    size_t _size = _end - _begin;
+    if (_size > CSV_MAX_BUFFER) {
+        return false;
+    }
+
+    // the last partial block is scanned from a padded copy
+    char _tail[CSV_BLOCK_SIZE];
+    for (size_t _offset = 0; _offset < _size; _offset += CSV_BLOCK_SIZE) {
+        const char* _block = _begin + _offset;
+        if (_size - _offset < CSV_BLOCK_SIZE) {
+            memset(_tail, 0, CSV_BLOCK_SIZE);
+            memcpy(_tail, _block, _size - _offset);
+            _block = _tail;
+        }
+
+        uint64_t _newlines;
+        uint64_t _mask = _scanner(_block, _newlines);
+        if (_mask == 0) {
+            continue;
+        }
+
+        size_t _count = _separators.size();
+        _separators.resize(_count + __builtin_popcountll(_mask));
+        uint32_t* _out = _separators.data() + _count;
+        while (_mask != 0) {
+            int _bit = __builtin_ctzll(_mask);
+            uint32_t _position = static_cast<uint32_t>(_offset + _bit);
+            if ((_newlines >> _bit) & 1) {
+                _position |= CSV_NEWLINE_FLAG;
+            }
+            *_out++ = _position;
+            _mask &= _mask - 1;
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * cusip.hpp
+ * Defines the fixed-width CUSIP identifier type.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef CUSIP_HPP
+#define CUSIP_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// Characters in a CUSIP
+constexpr int CUSIP_LENGTH = 9;
+
+// Hash the 9 characters of a CUSIP into 64 bits. The first 8 characters are
+// read as one little-endian word, which compilers turn into a single load.
+constexpr uint64_t HashCusip(const char* _cusip) {
+    uint64_t _word = 0;
+    for (int i = 0; i < 8; i++) {
+        _word |= uint64_t(static_cast<uint8_t>(_cusip[i])) << (8 * i);
+    }
+    uint64_t h = _word ^ (uint64_t(static_cast<uint8_t>(_cusip[8])) *
+                          0x9E3779B97F4A7C15ull);
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 31;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 29;
+    return h;
+}
+
+/**
+ * A CUSIP held inline as 9 characters zero padded to 16 aligned bytes.
+ * Equality, ordering and hashing work on the two 8-byte words, without
+ * the length checks and indirection of a string.
+ * Converts to a string_view of its 9 characters wherever text is expected.
+ */
+class alignas(16) Cusip {
+
+  public:
+    // ctor for an empty CUSIP, or from the first 9 characters of _id
+    constexpr Cusip() : chars{} {}
+    constexpr explicit Cusip(string_view _id) : chars{} {
+        for (size_t i = 0; i < _id.size() && i < CUSIP_LENGTH; i++) {
+            chars[i] = _id[i];
+        }
+    }
+
+    // Parse exactly 9 characters into a CUSIP, false if the length is wrong
+    static bool Parse(string_view _id, Cusip& _cusip);
+
+    // Get the characters of the CUSIP
+    constexpr string_view GetView() const {
+        return string_view(chars, IsEmpty() ? 0 : CUSIP_LENGTH);
+    }
+    constexpr operator string_view() const { return GetView(); }
+
+    // Get the CUSIP as a string
+    string ToString() const;
+
+    // Check whether no CUSIP is held
+    constexpr bool IsEmpty() const { return chars[0] == '\0'; }
+
+    // Get a hash of the CUSIP
+    size_t Hash() const;
+
+    friend bool operator==(const Cusip& a, const Cusip& b);
+    friend bool operator<(const Cusip& a, const Cusip& b);
+
+  private:
+    // Get the characters as two words, low then high
+    void GetWords(uint64_t& _low, uint64_t& _high) const;
+
+    char chars[16];
+};
+
+static_assert(sizeof(Cusip) == 16, "a Cusip is two aligned words");
+
+bool Cusip::Parse(string_view _id, Cusip& _cusip) {
+    if (_id.size() != CUSIP_LENGTH) {
+        return false;
+    }
+    _cusip = Cusip(_id);
+    return true;
+}
+
+string Cusip::ToString() const { return string(GetView()); }
+
+void Cusip::GetWords(uint64_t& _low, uint64_t& _high) const {
+    memcpy(&_low, chars, 8);
+    memcpy(&_high, chars + 8, 8);
+}
+
+size_t Cusip::Hash() const {
+    uint64_t _low, _high;
+    GetWords(_low, _high);
+    uint64_t h = (_low ^ (_high * 0x9E3779B97F4A7C15ull)) *
+                 0xBF58476D1CE4E5B9ull;
+    return static_cast<size_t>(h ^ (h >> 32));
+}
+
+bool operator==(const Cusip& a, const Cusip& b) {
+    uint64_t _aLow, _aHigh, _bLow, _bHigh;
+    a.GetWords(_aLow, _aHigh);
+    b.GetWords(_bLow, _bHigh);
+    return ((_aLow ^ _bLow) | (_aHigh ^ _bHigh)) == 0;
+}
+
+bool operator!=(const Cusip& a, const Cusip& b) { return !(a == b); }
+
+// Ordered as the characters are, like the string identifiers
+bool operator<(const Cusip& a, const Cusip& b) {
+    return memcmp(a.chars, b.chars, CUSIP_LENGTH) < 0;
+}
+
+ostream& operator<<(ostream& _output, const Cusip& _cusip) {
+    return _output << _cusip.GetView();
+}
+
+namespace std {
+template <> struct hash<Cusip> {
+    size_t operator()(const Cusip& _cusip) const { return _cusip.Hash(); }
+};
+} // namespace std
+
+#endif
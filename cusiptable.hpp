@@ -0,0 +1,141 @@
+/**
+ * cusiptable.hpp
+ * Defines a perfect hash over CUSIPs, built at compile time.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef CUSIP_TABLE_HPP
+#define CUSIP_TABLE_HPP
+
+#include "cusip.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+using namespace std;
+
+// Smallest power of two not below _n
+constexpr size_t CeilPowerOfTwo(size_t _n) {
+    size_t _power = 1;
+    while (_power < _n) {
+        _power <<= 1;
+    }
+    return _power;
+}
+
+/**
+ * Perfect hash from the CUSIPs of N records to their positions.
+ * A CUSIP is hashed once, its bucket gives the displacement placing it in
+ * a slot of its own, and the slot holds the record position along with the
+ * CUSIP to confirm the match. Lookups take a fixed number of steps with no
+ * probing. Built by MakeCusipTable in a constant expression.
+ */
+template <size_t N> struct CusipTable {
+    static constexpr size_t SLOTS = CeilPowerOfTwo(N + N / 4);
+    static constexpr size_t BUCKETS = CeilPowerOfTwo((N + 1) / 2);
+
+    // Get the position of the record with the CUSIP, -1 if there is none
+    int Find(const Cusip& _cusip) const;
+    int Find(string_view _cusip) const;
+
+    // Get the slot a CUSIP hashes to
+    constexpr size_t GetSlot(uint64_t _hash) const;
+
+    uint16_t offsets[BUCKETS][2];
+    int32_t positions[SLOTS];
+    Cusip cusips[SLOTS];
+};
+
+template <size_t N>
+constexpr size_t CusipTable<N>::GetSlot(uint64_t _hash) const {
+    size_t _bucket = (_hash >> 40) & (BUCKETS - 1);
+    // an odd step visits every slot of the power of two table
+    size_t _step = (_hash >> 20) | 1;
+    return (_hash + offsets[_bucket][0] * _step + offsets[_bucket][1]) &
+           (SLOTS - 1);
+}
+
+template <size_t N> int CusipTable<N>::Find(const Cusip& _cusip) const {
+    size_t _slot = GetSlot(HashCusip(_cusip.GetView().data()));
+    int _position = positions[_slot];
+    // empty slots hold empty CUSIPs, which can only match an empty one
+    return cusips[_slot] == _cusip && !_cusip.IsEmpty() ? _position : -1;
+}
+
+template <size_t N> int CusipTable<N>::Find(string_view _cusip) const {
+    Cusip _id;
+    return Cusip::Parse(_cusip, _id) ? Find(_id) : -1;
+}
+
+// Build the perfect hash of the records, each with a 'cusip' member.
+// Buckets are placed largest first, trying displacements until all of the
+// bucket's CUSIPs fall in free slots. Duplicate CUSIPs, or a set of records
+// for which no displacements are found, fail the constant evaluation.
+template <typename R, size_t N>
+constexpr CusipTable<N> MakeCusipTable(const R (&_records)[N]) {
+    constexpr size_t SLOTS = CusipTable<N>::SLOTS;
+    constexpr size_t BUCKETS = CusipTable<N>::BUCKETS;
+
+    CusipTable<N> _table{};
+    uint64_t _hashes[N]{};
+    size_t _buckets[N]{};
+    size_t _starts[BUCKETS + 1]{};
+    for (size_t i = 0; i < N; i++) {
+        _hashes[i] = HashCusip(_records[i].cusip);
+        _buckets[i] = (_hashes[i] >> 40) & (BUCKETS - 1);
+        _starts[_buckets[i] + 1]++;
+    }
+    for (size_t s = 0; s < SLOTS; s++) {
+        _table.positions[s] = -1;
+    }
+
+    // group the records by bucket, members of bucket b are found at
+    // _members[_starts[b]] up to _members[_starts[b + 1]]
+    size_t _largest = 0;
+    for (size_t b = 0; b < BUCKETS; b++) {
+        _largest = _starts[b + 1] > _largest ? _starts[b + 1] : _largest;
+        _starts[b + 1] += _starts[b];
+    }
+    size_t _members[N]{};
+    size_t _filled[BUCKETS]{};
+    for (size_t i = 0; i < N; i++) {
+        size_t b = _buckets[i];
+        _members[_starts[b] + _filled[b]++] = i;
+    }
+
+    size_t _slots[N]{};
+    for (size_t _size = _largest; _size > 0; _size--) {
+        for (size_t b = 0; b < BUCKETS; b++) {
+            if (_starts[b + 1] - _starts[b] != _size) {
+                continue;
+            }
+            const size_t* _bucket = _members + _starts[b];
+            bool _placed = false;
+            for (size_t d = 0; d < SLOTS * SLOTS && !_placed; d++) {
+                _table.offsets[b][0] = static_cast<uint16_t>(d / SLOTS);
+                _table.offsets[b][1] = static_cast<uint16_t>(d % SLOTS);
+                // the bucket fits if its slots are free and distinct
+                _placed = true;
+                for (size_t i = 0; i < _size && _placed; i++) {
+                    _slots[i] = _table.GetSlot(_hashes[_bucket[i]]);
+                    _placed = _table.positions[_slots[i]] == -1;
+                    for (size_t j = 0; j < i && _placed; j++) {
+                        _placed = _slots[j] != _slots[i];
+                    }
+                }
+            }
+            if (!_placed) {
+                throw logic_error("No perfect hash for the CUSIPs");
+            }
+            for (size_t i = 0; i < _size; i++) {
+                size_t _record = _bucket[i];
+                _table.positions[_slots[i]] = static_cast<int32_t>(_record);
+                _table.cusips[_slots[i]] = Cusip(_records[_record].cusip);
+            }
+        }
+    }
+    return _table;
+}
+
+#endif
@@ -0,0 +1,260 @@
+/**
+ * eventring.hpp
+ * Defines a sequenced event ring fanning one service's events out to several
+ * listeners, each reading the ring in place on a thread of its own.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef EVENT_RING_HPP
+#define EVENT_RING_HPP
+
+#include "asyncpipeline.hpp"
+#include "soa.hpp"
+#include "spscring.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Events published ahead of the slowest reader of a ring before its writer
+// has to wait
+constexpr size_t EVENT_RING_CAPACITY = 1024;
+
+/**
+ * Ring of sequenced events with a single writer and one reader per listener.
+ * Registered on a service in place of its listeners, it copies each event
+ * into the ring once, whatever the number of listeners, and publishes it by
+ * advancing a cursor. Each reader has a sequence of its own, the next event
+ * it reads, and hands the listener the events between its sequence and the
+ * cursor where they lie in the ring, as one batch per contiguous run.
+ * The writer reuses a slot only once every reader is past it, so the
+ * slowest reader holds the writer back, and the lag of each reader shows how
+ * far behind it is. Listeners share the events, so they must not change them.
+ * Only one thread may add events at a time.
+ * Type V is the data type.
+ */
+template <typename V>
+class EventRing : public AsyncStageBase, public ServiceListener<V> {
+
+  public:
+    // ctor for a ring of at least _capacity events, starting a reader for
+    // each listener
+    EventRing(const vector<ServiceListener<V>*>& _listeners,
+              size_t _capacity = EVENT_RING_CAPACITY);
+
+    // Read everything published, then stop the readers
+    ~EventRing();
+
+    // Listener callback to process an add event to the Service
+    void ProcessAdd(V& _data);
+
+    // Listener callback to process a remove event to the Service
+    void ProcessRemove(V& _data);
+
+    // Listener callback to process an update event to the Service
+    void ProcessUpdate(V& _data);
+
+    // Listener callback to process add events for a batch of data
+    void ProcessAddBatch(V* _data, size_t _count);
+
+    // Check whether every reader has read everything published
+    bool IsIdle() const;
+
+    // Get the number of events read so far, summed over the readers
+    uint64_t GetCompleted() const;
+
+    // Get the number of events the slowest reader has yet to read
+    size_t GetDepth() const;
+
+    // Get the number of events dropped, none since the writer waits
+    uint64_t GetDropped() const;
+
+    // Get the number of readers
+    size_t GetReaderCount() const;
+
+    // Get the number of events published which a reader has yet to read
+    uint64_t GetLag(size_t _reader) const;
+
+  private:
+    // A listener and its position in the ring
+    struct Reader {
+        ServiceListener<V>* listener;
+        // next event to read, written by the reader only
+        alignas(CACHE_LINE_SIZE) atomic<uint64_t> sequence;
+        thread worker;
+    };
+
+    // Copy up to _count events into free slots and publish them, returning
+    // the number published
+    size_t TryPublish(const V* _data, size_t _count);
+
+    // Get the sequence of the slowest reader
+    uint64_t GetMinimumSequence() const;
+
+    // Read the events published and hand them on until stopped
+    void Run(Reader* _reader);
+
+    vector<V> slots;
+    size_t mask;
+    vector<unique_ptr<Reader>> readers;
+    atomic<bool> stopping;
+
+    // events published, written by the writer only
+    alignas(CACHE_LINE_SIZE) atomic<uint64_t> cursor;
+    uint64_t cachedMinimum;
+};
+
+template <typename V>
+EventRing<V>::EventRing(const vector<ServiceListener<V>*>& _listeners,
+                        size_t _capacity)
+    : stopping(false), cursor(0), cachedMinimum(0) {
+    size_t _size = 1;
+    while (_size < _capacity) {
+        _size <<= 1;
+    }
+    slots.resize(_size);
+    mask = _size - 1;
+
+    for (auto& l : _listeners) {
+        readers.emplace_back(new Reader());
+        readers.back()->listener = l;
+        readers.back()->sequence.store(0);
+    }
+    for (auto& r : readers) {
+        r->worker = thread(&EventRing<V>::Run, this, r.get());
+    }
+}
+
+template <typename V> EventRing<V>::~EventRing() {
+    stopping.store(true);
+    for (auto& r : readers) {
+        r->worker.join();
+    }
+}
+
+template <typename V> void EventRing<V>::ProcessAdd(V& _data) {
+    while (TryPublish(&_data, 1) == 0) {
+        this_thread::yield();
+    }
+}
+
+template <typename V> void EventRing<V>::ProcessRemove(V& _data) {}
+
+template <typename V> void EventRing<V>::ProcessUpdate(V& _data) {}
+
+template <typename V>
+void EventRing<V>::ProcessAddBatch(V* _data, size_t _count) {
+    while (_count > 0) {
+        size_t _published = TryPublish(_data, _count);
+        if (_published == 0) {
+            this_thread::yield();
+        }
+        _data += _published;
+        _count -= _published;
+    }
+}
+
+template <typename V> bool EventRing<V>::IsIdle() const {
+    return GetMinimumSequence() == cursor.load();
+}
+
+template <typename V> uint64_t EventRing<V>::GetCompleted() const {
+    uint64_t _completed = 0;
+    for (auto& r : readers) {
+        _completed += r->sequence.load();
+    }
+    return _completed;
+}
+
+template <typename V> size_t EventRing<V>::GetDepth() const {
+    uint64_t _minimum = GetMinimumSequence();
+    return cursor.load() - _minimum;
+}
+
+template <typename V> uint64_t EventRing<V>::GetDropped() const { return 0; }
+
+template <typename V> size_t EventRing<V>::GetReaderCount() const {
+    return readers.size();
+}
+
+template <typename V> uint64_t EventRing<V>::GetLag(size_t _reader) const {
+    // the sequence is read first, so it never runs ahead of the cursor
+    uint64_t _sequence = readers[_reader]->sequence.load();
+    return cursor.load() - _sequence;
+}
+
+template <typename V>
+size_t EventRing<V>::TryPublish(const V* _data, size_t _count) {
+    uint64_t _cursor = cursor.load(memory_order_relaxed);
+    if (_cursor + _count - cachedMinimum > slots.size()) {
+        cachedMinimum = GetMinimumSequence();
+    }
+    size_t _free = slots.size() - (_cursor - cachedMinimum);
+    size_t _published = min(_count, _free);
+    for (size_t i = 0; i < _published; i++) {
+        slots[(_cursor + i) & mask] = _data[i];
+    }
+    cursor.store(_cursor + _published, memory_order_release);
+    return _published;
+}
+
+template <typename V> uint64_t EventRing<V>::GetMinimumSequence() const {
+    uint64_t _minimum = cursor.load(memory_order_relaxed);
+    for (auto& r : readers) {
+        _minimum = min(_minimum, r->sequence.load(memory_order_acquire));
+    }
+    return _minimum;
+}
+
+template <typename V> void EventRing<V>::Run(Reader* _reader) {
+    uint64_t _sequence = _reader->sequence.load(memory_order_relaxed);
+    int _polls = 0;
+    while (true) {
+        // stopping is checked before the cursor, so nothing published before
+        // the stop is left behind
+        bool _stopping = stopping.load();
+        uint64_t _cursor = cursor.load(memory_order_acquire);
+
+        if (_sequence < _cursor) {
+            // a run ends at the cursor or at the end of the slots
+            while (_sequence < _cursor) {
+                size_t _start = _sequence & mask;
+                size_t _run = min<uint64_t>(_cursor - _sequence,
+                                            slots.size() - _start);
+                if (_run == 1) {
+                    _reader->listener->ProcessAdd(slots[_start]);
+                } else {
+                    _reader->listener->ProcessAddBatch(&slots[_start], _run);
+                }
+                _sequence += _run;
+                _reader->sequence.store(_sequence, memory_order_release);
+            }
+            _polls = 0;
+        } else if (_stopping) {
+            return;
+        } else {
+            BackOff(++_polls);
+        }
+    }
+}
+
+// Get the listeners to register on a service for the given listeners: one
+// event ring read by all of them, owned by the pipeline, or the listeners
+// themselves when the pipeline is disabled
+template <typename V>
+vector<ServiceListener<V>*>
+Broadcast(AsyncPipeline& _pipeline,
+          const vector<ServiceListener<V>*>& _listeners) {
+    if (!_pipeline.IsEnabled()) {
+        return _listeners;
+    }
+    EventRing<V>* _ring = new EventRing<V>(_listeners);
+    _pipeline.Adopt(_ring);
+    return vector<ServiceListener<V>*>{_ring};
+}
+
+#endif
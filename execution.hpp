@@ -26,14 +26,17 @@ template <typename T> class ExecutionOrder {
   public:
     // Constructor for an order
     ExecutionOrder() = default;
-    ExecutionOrder(const T& _product, PricingSide _side, string _orderId,
-                   OrderType _orderType, double _price, double _visibleQuantity,
-                   double _hiddenQuantity, string _parentOrderId,
-                   bool _isChildOrder);
+    ExecutionOrder(ProductHandle<T> _product, PricingSide _side,
+                   string _orderId, OrderType _orderType, TickPrice _price,
+                   double _visibleQuantity, double _hiddenQuantity,
+                   string _parentOrderId, bool _isChildOrder);
 
     // Get the product associated with the order
     const T& GetProduct() const;
 
+    // Get the handle of the product
+    ProductHandle<T> GetProductHandle() const;
+
     // Get the pricing side (BID or OFFER)
     PricingSide GetPricingSide() const;
 
@@ -44,7 +47,7 @@ template <typename T> class ExecutionOrder {
     OrderType GetOrderType() const;
 
     // Get the price specified in the order
-    double GetPrice() const;
+    TickPrice GetPrice() const;
 
     // Get the visible quantity in the order
     long GetVisibleQuantity() const;
@@ -62,11 +65,11 @@ template <typename T> class ExecutionOrder {
     vector<string> PrintFunction() const;
 
   private:
-    T product;
+    ProductHandle<T> product;
     PricingSide side;
     string orderId;
     OrderType orderType;
-    double price;
+    TickPrice price;
     double visibleQuantity;
     double hiddenQuantity;
     string parentOrderId;
@@ -74,11 +77,12 @@ template <typename T> class ExecutionOrder {
 };
 
 template <typename T>
-ExecutionOrder<T>::ExecutionOrder(const T& _product, PricingSide _side,
-                                  string _orderId, OrderType _orderType,
-                                  double _price, double _visibleQuantity,
-                                  double _hiddenQuantity, string _parentOrderId,
-                                  bool _isChildOrder)
+ExecutionOrder<T>::ExecutionOrder(ProductHandle<T> _product,
+                                  PricingSide _side, string _orderId,
+                                  OrderType _orderType, TickPrice _price,
+                                  double _visibleQuantity,
+                                  double _hiddenQuantity,
+                                  string _parentOrderId, bool _isChildOrder)
     : product(_product) {
     side = _side;
     orderId = _orderId;
@@ -91,6 +95,11 @@ ExecutionOrder<T>::ExecutionOrder(const T& _product, PricingSide _side,
 }
 
 template <typename T> const T& ExecutionOrder<T>::GetProduct() const {
+    return product.Get();
+}
+
+template <typename T>
+ProductHandle<T> ExecutionOrder<T>::GetProductHandle() const {
     return product;
 }
 
@@ -106,7 +115,7 @@ template <typename T> OrderType ExecutionOrder<T>::GetOrderType() const {
     return orderType;
 }
 
-template <typename T> double ExecutionOrder<T>::GetPrice() const {
+template <typename T> TickPrice ExecutionOrder<T>::GetPrice() const {
     return price;
 }
 
@@ -128,7 +137,7 @@ template <typename T> bool ExecutionOrder<T>::IsChildOrder() const {
 }
 
 template <typename T> vector<string> ExecutionOrder<T>::PrintFunction() const {
-    string _product = product.GetProductId();
+    string _product = product.Get().GetProductId();
     string _side = (side == BID) ? "BID" : "OFFER";
     string _orderId = orderId;
     string _orderType;
@@ -20,11 +20,11 @@ class ExecutionServiceListener;
 
 /**
  * Service for executing orders on an exchange.
- * Keyed on product identifier.
+ * Keyed on product CUSIP, held by product index.
  * Type T is the product type.
  */
 template<typename T>
-class ExecutionService : public Service<string,ExecutionOrder <T> >
+class ExecutionService : public Service<Cusip,ExecutionOrder <T> >
 {
 public:
 
@@ -32,7 +32,7 @@ public:
     ExecutionService();
 
     // Get data on our service given a key
-    ExecutionOrder<T>& GetData(string _id);
+    ExecutionOrder<T>& GetData(Cusip _id);
 
     // The callback that a Connector should invoke for any new or updated data
     void OnMessage(ExecutionOrder<T>& _data);
@@ -47,10 +47,13 @@ public:
     ExecutionServiceListener<T>* GetListener();
 
     // Execute order upon receiving an execution request.
+    // _emit(ExecutionOrder<T>&) is handed the order in place of the listeners.
     void ExecuteOrder(ExecutionOrder<T>& _executionOrder);
+    template <typename F>
+    void ExecuteOrder(ExecutionOrder<T>& _executionOrder, F _emit);
 
 private:
-    map<string, ExecutionOrder<T>> executionOrders;
+    ProductTable<ExecutionOrder<T>> executionOrders;
     vector<ServiceListener<ExecutionOrder<T>>*> listeners;
     ExecutionServiceListener<T>* listener;
 };
@@ -58,21 +61,20 @@ private:
 template<typename T>
 ExecutionService<T>::ExecutionService()
 {
-    executionOrders = map<string, ExecutionOrder<T>>();
     listeners = vector<ServiceListener<ExecutionOrder<T>>*>();
     listener = new ExecutionServiceListener<T>(this);
 }
 
 template<typename T>
-ExecutionOrder<T>& ExecutionService<T>::GetData(string _id)
+ExecutionOrder<T>& ExecutionService<T>::GetData(Cusip _id)
 {
-    return executionOrders[_id];
+    return executionOrders[GetProductRegistry<T>().At(_id)];
 }
 
 template<typename T>
 void ExecutionService<T>::OnMessage(ExecutionOrder<T>& _data)
 {
-    executionOrders[_data.GetProduct().GetProductId()] = _data;
+    executionOrders.Insert(_data.GetProductHandle().GetIndex(), _data);
 }
 
 template<typename T>
@@ -96,12 +98,19 @@ ExecutionServiceListener<T>* ExecutionService<T>::GetListener()
 template<typename T>
 void ExecutionService<T>::ExecuteOrder(ExecutionOrder<T>& _executionOrder)
 {
-    executionOrders[_executionOrder.GetProduct().GetProductId()] = _executionOrder;
+    ExecuteOrder(_executionOrder,
+                 ListenerEmitter<ExecutionOrder<T>>(listeners));
+}
+
+template<typename T>
+template<typename F>
+void ExecutionService<T>::ExecuteOrder(ExecutionOrder<T>& _executionOrder,
+                                       F _emit)
+{
+    executionOrders.Insert(_executionOrder.GetProductHandle().GetIndex(),
+                           _executionOrder);
 
-    for (auto& l : listeners)
-    {
-        l->ProcessAdd(_executionOrder);
-    }
+    _emit(_executionOrder);
 }
 
 /**
@@ -118,6 +127,7 @@ public:
 
     // Listener callback to process an add event to the Service
     void ProcessAdd(AlgoExecution<T>& _data);
+    template<typename F> void ProcessAdd(AlgoExecution<T>& _data, F _emit);
 
     // Listener callback to process a remove event to the Service
     void ProcessRemove(AlgoExecution<T>& _data);
@@ -137,12 +147,20 @@ ExecutionServiceListener<T>::ExecutionServiceListener(ExecutionService<T>* _serv
 
 template<typename T>
 void ExecutionServiceListener<T>::ProcessAdd(AlgoExecution<T>& _data)
+{
+    ProcessAdd(_data,
+               ListenerEmitter<ExecutionOrder<T>>(service->GetListeners()));
+}
+
+template<typename T>
+template<typename F>
+void ExecutionServiceListener<T>::ProcessAdd(AlgoExecution<T>& _data, F _emit)
 {
     ExecutionOrder<T>* execution_order = _data.GetExecutionOrder();
 
     service->OnMessage(*execution_order);
 
-    service->ExecuteOrder(*execution_order);
+    service->ExecuteOrder(*execution_order, _emit);
 }
 
 template<typename T>
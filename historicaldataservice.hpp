@@ -15,20 +15,59 @@
 #include "inquiryservice.hpp"
 #include "positionservice.hpp"
 #include "riskservice.hpp"
+#include "bufferedwriter.hpp"
+#include "columnarstore.hpp"
+#include "historicalquery.hpp"
+#include "persistencethread.hpp"
 #include "soa.hpp"
 #include "streamingservice.hpp"
 #include "utility.hpp"
 
+// Get the output file of a service type
+string GetHistoricalDataPath(const string& _type) {
+    if (_type == "Position") {
+        return "Data/Output/positions.txt";
+    } else if (_type == "Risk") {
+        return "Data/Output/risk.txt";
+    } else if (_type == "Execution") {
+        return "Data/Output/executions.txt";
+    } else if (_type == "Streaming") {
+        return "Data/Output/streaming.txt";
+    } else if (_type == "Inquiry") {
+        return "Data/Output/allinquiries.txt";
+    }
+    cerr << "Error: Unknown historical data type " << _type << endl;
+    return "Data/Output/" + _type + ".txt";
+}
+
+/**
+ * Format of a historical data file: comma separated text, one record a line,
+ * or the binary columnar format of columnarstore.hpp.
+ */
+enum HistoricalFormat { TEXT_FORMAT, COLUMNAR_FORMAT };
+
+// Get the historical data format of a name: text or columnar
+bool ParseHistoricalFormat(const string& _name, HistoricalFormat& _format) {
+    if (_name == "text") {
+        _format = TEXT_FORMAT;
+    } else if (_name == "columnar") {
+        _format = COLUMNAR_FORMAT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
 // Forward declarations to avoid errors.
 template <typename V> class HistoricalDataConnector;
 template <typename V> class HistoricalDataListener;
 
 /**
  * Service for processing and persisting historical data to a persistent store.
- * Keyed on some persistent key.
+ * Keyed on the CUSIP of the product.
  * Type V is the data type to persist.
  */
-template <typename V> class HistoricalDataService : Service<string, V> {
+template <typename V> class HistoricalDataService : Service<Cusip, V> {
 
   public:
     // Constructors
@@ -36,7 +75,7 @@ template <typename V> class HistoricalDataService : Service<string, V> {
     HistoricalDataService(string _type);
 
     // Get data associated with a key
-    V& GetData(string _key);
+    V& GetData(Cusip _key);
 
     // Callback for a Connector to invoke with new or updated data
     void OnMessage(V& _data);
@@ -51,25 +90,76 @@ template <typename V> class HistoricalDataService : Service<string, V> {
     HistoricalDataConnector<V>* GetConnector();
 
     // Get the listener of the service
-    ServiceListener<V>* GetServiceListener();
+    HistoricalDataListener<V>* GetServiceListener();
 
     // Get the service type
     // Possible values: "Position", "Risk", "Execution", "Streaming", "Inquiry"
     string GetServiceType() const;
 
     // Persist data locally
-    void PersistData(string _persistKey, V& _data);
+    void PersistData(const Cusip& _persistKey, V& _data);
+
+    // Persist a batch of data locally in one write to the store
+    void PersistBatch(V* _data, size_t _count);
+
+    // Get the writer of the output file, held open by the service
+    BufferedWriter& GetWriter();
+
+    // Set how durable each persisted batch is before the service carries on
+    void SetDurability(DurabilityPolicy _durability);
+
+    // Set how the output file is written, before anything is persisted
+    void SetWriterBackend(WriterBackend _backend);
+
+    // Set the format of the output file, before anything is persisted.
+    // Columnar files take the .col extension in place of .txt.
+    void SetFormat(HistoricalFormat _format);
+
+    // Get the columnar writer of the output file, null for text
+    ColumnarWriter<V>* GetColumnarWriter();
+
+    // Get the persisted records of a product stamped between two times from
+    // the columnar output file. The file is mapped on the first query and
+    // refreshed with the blocks appended since on later ones. Records not
+    // yet written to the file are not seen. Text output cannot be queried:
+    // the query is reported and nothing is returned.
+    vector<pair<ptime, V>> Query(const string& _productId,
+                                 const ptime& _start, const ptime& _end);
+
+    // Persist data on a persistence thread from now on, queueing it as it
+    // comes in place of writing it
+    void SetPersistenceThread(PersistenceThread* _thread);
+
+    // Write what has waited in the buffers of the output file past the time
+    // threshold
+    void FlushIfDue();
+
+    // Have a flush timer write the output file on time
+    void SetFlushTimer(FlushTimer* _timer);
+
+    // Get the lock the output file is written under
+    mutex& GetWriteLock();
 
   private:
-    map<string, V> historicalDatas;
+    unordered_map<Cusip, V> historicalDatas;
     vector<ServiceListener<V>*> listeners;
     HistoricalDataConnector<V>* connector;
-    ServiceListener<V>* listener;
+    HistoricalDataListener<V>* listener;
     string type;
+    BufferedWriter writer;
+    // goes before the writer it writes its last block to
+    unique_ptr<ColumnarWriter<V>> columnar;
+    PersistenceQueue<V>* queue;
+    // held by each batch written, and by the flush timer
+    mutex writeLock;
+    // queries of the columnar output file, opened by the first one
+    unique_ptr<HistoricalQuery<V>> query;
+    mutex queryLock;
 };
 
-template <typename V> HistoricalDataService<V>::HistoricalDataService() {
-    historicalDatas = map<string, V>();
+template <typename V>
+HistoricalDataService<V>::HistoricalDataService()
+    : writer(GetHistoricalDataPath("Position")), queue(nullptr) {
     listeners = vector<ServiceListener<V>*>();
     connector = new HistoricalDataConnector<V>(this);
     listener = new HistoricalDataListener<V>(this);
@@ -77,20 +167,20 @@ template <typename V> HistoricalDataService<V>::HistoricalDataService() {
 }
 
 template <typename V>
-HistoricalDataService<V>::HistoricalDataService(string _type) {
-    historicalDatas = map<string, V>();
+HistoricalDataService<V>::HistoricalDataService(string _type)
+    : writer(GetHistoricalDataPath(_type)), queue(nullptr) {
     listeners = vector<ServiceListener<V>*>();
     connector = new HistoricalDataConnector<V>(this);
     listener = new HistoricalDataListener<V>(this);
     type = _type;
 }
 
-template <typename V> V& HistoricalDataService<V>::GetData(string _key) {
+template <typename V> V& HistoricalDataService<V>::GetData(Cusip _key) {
     return historicalDatas[_key];
 }
 
 template <typename V> void HistoricalDataService<V>::OnMessage(V& _data) {
-    historicalDatas[_data.GetProduct().GetProductId()] = _data;
+    historicalDatas[_data.GetProduct().GetCusip()] = _data;
 }
 
 template <typename V>
@@ -110,7 +200,7 @@ HistoricalDataConnector<V>* HistoricalDataService<V>::GetConnector() {
 }
 
 template <typename V>
-ServiceListener<V>* HistoricalDataService<V>::GetServiceListener() {
+HistoricalDataListener<V>* HistoricalDataService<V>::GetServiceListener() {
     return listener;
 }
 
@@ -119,8 +209,98 @@ template <typename V> string HistoricalDataService<V>::GetServiceType() const {
 }
 
 template <typename V>
-void HistoricalDataService<V>::PersistData(string _persistKey, V& _data) {
-    connector->Publish(_data);
+void HistoricalDataService<V>::PersistData(const Cusip& _persistKey,
+                                           V& _data) {
+    if (queue != nullptr) {
+        queue->Push(_data);
+    } else {
+        connector->Publish(_data);
+    }
+}
+
+template <typename V>
+void HistoricalDataService<V>::PersistBatch(V* _data, size_t _count) {
+    if (queue != nullptr) {
+        for (size_t i = 0; i < _count; i++) {
+            queue->Push(_data[i]);
+        }
+    } else {
+        connector->PublishBatch(_data, _count);
+    }
+}
+
+template <typename V> BufferedWriter& HistoricalDataService<V>::GetWriter() {
+    return writer;
+}
+
+template <typename V>
+void HistoricalDataService<V>::SetDurability(DurabilityPolicy _durability) {
+    writer.SetDurability(_durability);
+}
+
+template <typename V>
+void HistoricalDataService<V>::SetWriterBackend(WriterBackend _backend) {
+    writer.SetBackend(_backend);
+}
+
+template <typename V>
+void HistoricalDataService<V>::SetFormat(HistoricalFormat _format) {
+    query.reset();
+    if (_format == TEXT_FORMAT) {
+        columnar.reset();
+        writer.SetPath(GetHistoricalDataPath(type));
+        return;
+    }
+    string _path = GetHistoricalDataPath(type);
+    writer.SetPath(_path.substr(0, _path.rfind('.')) + ".col");
+    columnar.reset(new ColumnarWriter<V>(writer));
+}
+
+template <typename V>
+ColumnarWriter<V>* HistoricalDataService<V>::GetColumnarWriter() {
+    return columnar.get();
+}
+
+template <typename V>
+vector<pair<ptime, V>>
+HistoricalDataService<V>::Query(const string& _productId, const ptime& _start,
+                                const ptime& _end) {
+    if (!columnar) {
+        cerr << "Error: " << type << " historical data is written as text, "
+             << "which cannot be queried" << endl;
+        return {};
+    }
+    lock_guard<mutex> _lock(queryLock);
+    if (!query) {
+        query.reset(new HistoricalQuery<V>(writer.GetPath()));
+    } else {
+        query->Refresh();
+    }
+    return query->Query(_productId, _start, _end);
+}
+
+template <typename V>
+void HistoricalDataService<V>::SetPersistenceThread(
+    PersistenceThread* _thread) {
+    queue = _thread->AddQueue<V>(connector, [this]() { FlushIfDue(); });
+}
+
+template <typename V> void HistoricalDataService<V>::FlushIfDue() {
+    lock_guard<mutex> _lock(writeLock);
+    if (columnar) {
+        columnar->FlushIfDue();
+    } else {
+        writer.FlushIfDue();
+    }
+}
+
+template <typename V>
+void HistoricalDataService<V>::SetFlushTimer(FlushTimer* _timer) {
+    _timer->Add([this]() { FlushIfDue(); });
+}
+
+template <typename V> mutex& HistoricalDataService<V>::GetWriteLock() {
+    return writeLock;
 }
 
 /**
@@ -136,9 +316,17 @@ template <typename V> class HistoricalDataConnector : public Connector<V> {
     // Publish data to the Connector
     void Publish(V& _data);
 
-    // Subscribe data from the Connector
+    // Publish a batch of data through the service's writer, as one batch
+    void PublishBatch(V* _data, size_t _count);
+
+    // Subscribe data from the Connector. Historical data is read back from
+    // the service's own output file, so the stream is not read.
     void Subscribe(ifstream& _data);
 
+    // Flow the records persisted in the columnar output file into the
+    // service, leaving it with the latest record of each product
+    void Subscribe();
+
   private:
     HistoricalDataService<V>* service;
 };
@@ -150,60 +338,48 @@ HistoricalDataConnector<V>::HistoricalDataConnector(
 }
 
 template <typename V> void HistoricalDataConnector<V>::Publish(V& _data) {
-    string _type = service->GetServiceType();
-    ofstream _file;
-    if (_type == "Position") {
-        _file.open("Data/Output/positions.txt", ios::app);
-        if (!_file.is_open()) {
-            cerr << "Error: Unable to open file at "
-                 << "Data/Output/positions.txt" << endl;
-            return;
-        }
-    }
-    if (_type == "Risk") {
-        _file.open("Data/Output/risk.txt", ios::app);
-        if (!_file.is_open()) {
-            cerr << "Error: Unable to open file at "
-                 << "Data/Output/risk.txt" << endl;
-            return;
-        }
-    }
-    if (_type == "Execution") {
-        _file.open("Data/Output/executions.txt", ios::app);
-        if (!_file.is_open()) {
-            cerr << "Error: Unable to open file at "
-                 << "Data/Output/execution.txt" << endl;
-            return;
-        }
-    }
-    if (_type == "Streaming") {
-        _file.open("Data/Output/streaming.txt", ios::app);
-        if (!_file.is_open()) {
-            cerr << "Error: Unable to open file at "
-                 << "Data/Output/streaming.txt" << endl;
-            return;
-        }
-    }
-    if (_type == "Inquiry") {
-        _file.open("Data/Output/allinquiries.txt", ios::app);
-        if (!_file.is_open()) {
-            cerr << "Error: Unable to open file at "
-                 << "Data/Output/allinquiries.txt" << endl;
-            return;
+    PublishBatch(&_data, 1);
+}
+
+template <typename V>
+void HistoricalDataConnector<V>::PublishBatch(V* _data, size_t _count) {
+    lock_guard<mutex> _lock(service->GetWriteLock());
+    ColumnarWriter<V>* _columnar = service->GetColumnarWriter();
+    if (_columnar != nullptr) {
+        for (size_t i = 0; i < _count; i++) {
+            _columnar->Add(_data[i], GetLocalMicroseconds());
         }
+        _columnar->Commit();
+        return;
     }
-    auto now = microsec_clock::local_time();
-    _file << now << ",";
 
-    vector<string> _dataStrings = _data.PrintFunction();
-    for (auto& s : _dataStrings) {
-        _file << s << ",";
+    BufferedWriter& _writer = service->GetWriter();
+    for (size_t i = 0; i < _count; i++) {
+        _writer.Append(to_simple_string(microsec_clock::local_time()));
+        _writer.Append(',');
+
+        vector<string> _dataStrings = _data[i].PrintFunction();
+        for (auto& s : _dataStrings) {
+            _writer.Append(s);
+            _writer.Append(',');
+        }
+        _writer.Append('\n');
     }
-    _file << endl;
+    _writer.Commit();
 }
 
 template <typename V>
-void HistoricalDataConnector<V>::Subscribe(ifstream& _data) {}
+void HistoricalDataConnector<V>::Subscribe(ifstream& _data) {
+    Subscribe();
+}
+
+template <typename V> void HistoricalDataConnector<V>::Subscribe() {
+    ptime _start(boost::posix_time::min_date_time);
+    ptime _end(boost::posix_time::max_date_time);
+    for (auto& _record : service->Query("", _start, _end)) {
+        service->OnMessage(_record.second);
+    }
+}
 
 /**
  * Service Listener subscribing data to Historical Data.
@@ -224,6 +400,9 @@ template <typename V> class HistoricalDataListener : public ServiceListener<V> {
     // Listener callback to process an add event to the Service
     void ProcessAdd(V& _data);
 
+    // Listener callback to process add events for a batch of data
+    void ProcessAddBatch(V* _data, size_t _count);
+
     // Listener callback to process a remove event to the Service
     void ProcessRemove(V& _data);
 
@@ -240,8 +419,12 @@ HistoricalDataListener<V>::HistoricalDataListener(
 template <typename V> HistoricalDataListener<V>::~HistoricalDataListener() {}
 
 template <typename V> void HistoricalDataListener<V>::ProcessAdd(V& _data) {
-    string _persistKey = _data.GetProduct().GetProductId();
-    service->PersistData(_persistKey, _data);
+    service->PersistData(_data.GetProduct().GetCusip(), _data);
+}
+
+template <typename V>
+void HistoricalDataListener<V>::ProcessAddBatch(V* _data, size_t _count) {
+    service->PersistBatch(_data, _count);
 }
 
 template <typename V> void HistoricalDataListener<V>::ProcessRemove(V& _data) {}
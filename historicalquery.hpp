@@ -0,0 +1,130 @@
+/**
+ * historicalquery.hpp
+ * Defines queries of the records of a product over a time range in a
+ * columnar historical data file.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef HISTORICAL_QUERY_HPP
+#define HISTORICAL_QUERY_HPP
+
+#include "columnarstore.hpp"
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Query of the records of one type in a columnar historical data file. The
+ * file is mapped once; each query binary-searches the block index on time,
+ * skips the blocks without the product, and decodes only the blocks left.
+ * The query sees what has reached the file when it was opened or last
+ * refreshed, not records still buffered by the writer.
+ * Type V is the data type.
+ */
+template <typename V> class HistoricalQuery {
+
+  public:
+    // ctor for queries of the columnar file at the path
+    HistoricalQuery(const string& _path);
+
+    // Check whether the file holds records of type V
+    bool IsValid() const;
+
+    // Take in the blocks written to the file since it was opened or last
+    // refreshed, without reading it again
+    void Refresh();
+
+    // Get the records of a product stamped between two times, inclusive,
+    // with their stamps, in the order they were written. An empty product
+    // matches every product.
+    vector<pair<ptime, V>> Query(const string& _productId, const ptime& _start,
+                                 const ptime& _end) const;
+
+    // Get the number of blocks decoded by the last query
+    size_t GetBlocksRead() const;
+
+  private:
+    // Check that the file was written with the schema of V
+    bool CheckColumns() const;
+
+    ColumnarReader reader;
+    bool valid;
+    mutable size_t blocksRead;
+};
+
+template <typename V>
+HistoricalQuery<V>::HistoricalQuery(const string& _path)
+    : reader(_path), valid(false), blocksRead(0) {
+    valid = reader.IsValid() && CheckColumns();
+    if (reader.IsValid() && !valid) {
+        cerr << "Error: Unexpected columns in columnar file at " << _path
+             << endl;
+    }
+}
+
+template <typename V> bool HistoricalQuery<V>::IsValid() const {
+    return valid;
+}
+
+template <typename V> void HistoricalQuery<V>::Refresh() {
+    bool _wasValid = reader.IsValid();
+    if (reader.Refresh() && !_wasValid) {
+        // the header has only just been read
+        valid = reader.IsValid() && CheckColumns();
+    }
+}
+
+template <typename V> bool HistoricalQuery<V>::CheckColumns() const {
+    vector<ColumnSpec> _specs = ColumnarSchema<V>::GetColumns();
+    const vector<ColumnSpec>& _columns = reader.GetColumns();
+    bool _matches = _columns.size() == _specs.size() + 1;
+    for (size_t i = 0; _matches && i < _specs.size(); i++) {
+        _matches = _columns[i + 1].name == _specs[i].name &&
+                   _columns[i + 1].encoding == _specs[i].encoding;
+    }
+    return _matches;
+}
+
+template <typename V>
+vector<pair<ptime, V>>
+HistoricalQuery<V>::Query(const string& _productId, const ptime& _start,
+                          const ptime& _end) const {
+    vector<pair<ptime, V>> _records;
+    blocksRead = 0;
+    if (!valid) {
+        return _records;
+    }
+
+    int64_t _from = ToMicroseconds(_start);
+    int64_t _to = ToMicroseconds(_end);
+    size_t _count = reader.GetColumns().size();
+    for (size_t b : reader.FindBlocks(_productId, _from, _to)) {
+        ColumnCursor _time;
+        vector<ColumnCursor> _columns(_count - 1);
+        reader.GetCursor(b, 0, _time);
+        for (size_t i = 1; i < _count; i++) {
+            reader.GetCursor(b, i, _columns[i - 1]);
+        }
+        blocksRead++;
+
+        int64_t _stamp;
+        V _data;
+        while (_time.GetInteger(_stamp) &&
+               ColumnarSchema<V>::ReadRow(_columns, _data)) {
+            if (_stamp >= _from && _stamp <= _to &&
+                (_productId.empty() ||
+                 _data.GetProduct().GetProductId() == _productId)) {
+                _records.emplace_back(FromMicroseconds(_stamp), _data);
+            }
+        }
+    }
+    return _records;
+}
+
+template <typename V> size_t HistoricalQuery<V>::GetBlocksRead() const {
+    return blocksRead;
+}
+
+#endif
@@ -24,8 +24,8 @@ template <typename T> class Inquiry {
   public:
     // ctor for an inquiry
     Inquiry() = default;
-    Inquiry(string _inquiryId, const T& _product, Side _side, long _quantity,
-            double _price, InquiryState _state);
+    Inquiry(string _inquiryId, ProductHandle<T> _product, Side _side,
+            long _quantity, TickPrice _price, InquiryState _state);
 
     // Get the inquiry ID
     const string& GetInquiryId() const;
@@ -33,6 +33,9 @@ template <typename T> class Inquiry {
     // Get the product
     const T& GetProduct() const;
 
+    // Get the handle of the product
+    ProductHandle<T> GetProductHandle() const;
+
     // Get the side on the inquiry
     Side GetSide() const;
 
@@ -40,13 +43,13 @@ template <typename T> class Inquiry {
     long GetQuantity() const;
 
     // Get the price that we have responded back with
-    double GetPrice() const;
+    TickPrice GetPrice() const;
 
     // Get the current state on the inquiry
     InquiryState GetState() const;
 
     // Set the price that we have responded back with
-    void SetPrice(double _price);
+    void SetPrice(TickPrice _price);
 
     // Set the current state on the inquiry
     void SetState(InquiryState _state);
@@ -55,16 +58,17 @@ template <typename T> class Inquiry {
 
   private:
     string inquiryId;
-    T product;
+    ProductHandle<T> product;
     Side side;
     long quantity;
-    double price;
+    TickPrice price;
     InquiryState state;
 };
 
 template <typename T>
-Inquiry<T>::Inquiry(string _inquiryId, const T& _product, Side _side,
-                    long _quantity, double _price, InquiryState _state)
+Inquiry<T>::Inquiry(string _inquiryId, ProductHandle<T> _product,
+                    Side _side, long _quantity, TickPrice _price,
+                    InquiryState _state)
     : product(_product) {
     inquiryId = _inquiryId;
     side = _side;
@@ -78,6 +82,11 @@ template <typename T> const string& Inquiry<T>::GetInquiryId() const {
 }
 
 template <typename T> const T& Inquiry<T>::GetProduct() const {
+    return product.Get();
+}
+
+template <typename T>
+ProductHandle<T> Inquiry<T>::GetProductHandle() const {
     return product;
 }
 
@@ -85,13 +94,13 @@ template <typename T> Side Inquiry<T>::GetSide() const { return side; }
 
 template <typename T> long Inquiry<T>::GetQuantity() const { return quantity; }
 
-template <typename T> double Inquiry<T>::GetPrice() const { return price; }
+template <typename T> TickPrice Inquiry<T>::GetPrice() const { return price; }
 
 template <typename T> InquiryState Inquiry<T>::GetState() const {
     return state;
 }
 
-template <typename T> void Inquiry<T>::SetPrice(double _price) {
+template <typename T> void Inquiry<T>::SetPrice(TickPrice _price) {
     price = _price;
 }
 
@@ -101,7 +110,7 @@ template <typename T> void Inquiry<T>::SetState(InquiryState _state) {
 
 template <typename T> vector<string> Inquiry<T>::PrintFunction() const {
     string _inquiryId = inquiryId;
-    string _product = product.GetProductId();
+    string _product = product.Get().GetProductId();
     string _side;
     switch (side) {
     case BUY:
@@ -166,7 +175,7 @@ class InquiryService : public Service<string, Inquiry<T>> {
     InquiryConnector<T>* GetConnector();
 
     // Send a quote back to the client
-    void SendQuote(const string& _inquiryId, double _price);
+    void SendQuote(const string& _inquiryId, TickPrice _price);
 
     // Reject an inquiry from the client
     void RejectInquiry(const string& _inquiryId);
@@ -221,7 +230,8 @@ template <typename T> InquiryConnector<T>* InquiryService<T>::GetConnector() {
 }
 
 template <typename T>
-void InquiryService<T>::SendQuote(const string& _inquiryId, double _price) {
+void InquiryService<T>::SendQuote(const string& _inquiryId,
+                                  TickPrice _price) {
     Inquiry<T>& _inquiry = inquiries[_inquiryId];
 
     // update the inquiry price, then register the listeners
@@ -257,9 +267,16 @@ template <typename T> class InquiryConnector : public Connector<Inquiry<T>> {
     // Subscribe data from the Connector
     void Subscribe(ifstream& _data);
 
+    // Subscribe data from lines of a memory mapped source
+    void Subscribe(LineSource& _data);
+
     // Re-subscribe data from the Connector
     // Needed for subscribing the data from inquiries after updating status
     void Subscribe(Inquiry<T>& _data);
+
+  private:
+    // Parse the fields of one line and flow the inquiry to the service
+    void ProcessFields(const string_view* vecs, int _count);
 };
 
 template <typename T>
@@ -278,38 +295,62 @@ template <typename T> void InquiryConnector<T>::Publish(Inquiry<T>& _data) {
 // Read from "inquiries.txt" and process the data.
 template <typename T> void InquiryConnector<T>::Subscribe(ifstream& _data) {
     string line;
+    string_view vecs[6];
     while (getline(_data, line)) {
+        ProcessFields(vecs, SplitFields(line, vecs, 6));
+    }
+}
 
-        stringstream lineStream(line);
-        string tmp;
-        vector<string> vecs;
-        while (getline(lineStream, tmp, ',')) {
-            vecs.push_back(tmp);
-        }
+template <typename T> void InquiryConnector<T>::Subscribe(LineSource& _data) {
+    string_view vecs[6];
+    int _count;
+    while ((_count = _data.GetFields(vecs, 6)) >= 0) {
+        ProcessFields(vecs, _count);
+    }
+}
 
-        string _inquiryId = vecs[0];
-        string _productId = vecs[1];
-        Side _side = vecs[2] == "BUY" ? BUY : SELL;
-        long _quantity = stol(vecs[3]);
-        double _price = string2price(vecs[4]);
-        InquiryState _state;
-        if (vecs[5] == "RECEIVED") {
-            _state = RECEIVED;
-        } else if (vecs[5] == "QUOTED") {
-            _state = QUOTED;
-        } else if (vecs[5] == "DONE") {
-            _state = DONE;
-        } else if (vecs[5] == "REJECTED") {
-            _state = REJECTED;
-        } else if (vecs[5] == "CUSTOMER_REJECTED") {
-            _state = CUSTOMER_REJECTED;
-        }
+template <typename T>
+void InquiryConnector<T>::ProcessFields(const string_view* vecs,
+                                        int _count) {
+    if (_count < 6) {
+        cerr << "Error: Invalid inquiry line " << vecs[0] << endl;
+        return;
+    }
 
-        T _product = GetBond(_productId);
-        Inquiry<T> _inquiry(_inquiryId, _product, _side, _quantity, _price,
-                            _state);
-        service->OnMessage(_inquiry);
+    const ProductRegistry<T>& _registry = GetProductRegistry<T>();
+    ProductIndex _index = _registry.Find(vecs[1]);
+    if (_index == INVALID_PRODUCT_INDEX) {
+        cerr << "Error: Unknown product " << vecs[1] << endl;
+        return;
     }
+    string _inquiryId(vecs[0]);
+    Side _side = vecs[2] == "BUY" ? BUY : SELL;
+    long _quantity;
+    if (!ParseLong(vecs[3], _quantity)) {
+        cerr << "Error: Invalid quantity " << vecs[3] << endl;
+        return;
+    }
+    TickPrice _price;
+    if (ParsePrice(vecs[4], _price) != PRICE_OK) {
+        cerr << "Error: Invalid price " << vecs[4] << endl;
+        return;
+    }
+    InquiryState _state;
+    if (vecs[5] == "RECEIVED") {
+        _state = RECEIVED;
+    } else if (vecs[5] == "QUOTED") {
+        _state = QUOTED;
+    } else if (vecs[5] == "DONE") {
+        _state = DONE;
+    } else if (vecs[5] == "REJECTED") {
+        _state = REJECTED;
+    } else if (vecs[5] == "CUSTOMER_REJECTED") {
+        _state = CUSTOMER_REJECTED;
+    }
+
+    Inquiry<T> _inquiry(_inquiryId, _index, _side, _quantity, _price,
+                        _state);
+    service->OnMessage(_inquiry);
 }
 
 template <typename T> void InquiryConnector<T>::Subscribe(Inquiry<T>& _data) {
@@ -9,6 +9,8 @@
 #include "AlgoStreamingService.hpp"
 #include "DataGenerator.hpp"
 #include "GUIservice.hpp"
+#include "asyncpipeline.hpp"
+#include "eventring.hpp"
 #include "executionservice.hpp"
 #include "historicaldataservice.hpp"
 #include "inquiryservice.hpp"
@@ -17,19 +19,167 @@
 #include "pricingservice.hpp"
 #include "products.hpp"
 #include "riskservice.hpp"
+#include "shardedruntime.hpp"
 #include "soa.hpp"
+#include "staticgraph.hpp"
 #include "streamingservice.hpp"
 #include "tradebookingservice.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <random>
 
-int main() {
+// Largest thread or shard count an option takes
+constexpr long MAX_OPTION_COUNT = 1024;
+
+// Options which are followed by a value
+const char* const VALUE_OPTIONS[] = {
+    "--ingest-threads", "--shards",         "--work-stealing", "--overflow",
+    "--writer",         "--history-format", "--durability"};
+
+// Parse the count given to an option, false unless it is a whole number
+// from 0 to MAX_OPTION_COUNT
+bool ParseOptionCount(const char* _text, int& _count) {
+    char* _end;
+    errno = 0;
+    long _value = strtol(_text, &_end, 10);
+    if (_end == _text || *_end != '\0' || errno == ERANGE || _value < 0 ||
+        _value > MAX_OPTION_COUNT) {
+        return false;
+    }
+    _count = static_cast<int>(_value);
+    return true;
+}
+
+// Whether an option is followed by a value
+bool IsValueOption(const char* _option) {
+    for (const char* _valueOption : VALUE_OPTIONS) {
+        if (strcmp(_option, _valueOption) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    // Option: --ingest-threads N parses prices.txt and marketdata.txt on a
+    // pool of N threads; by default the inputs are parsed on the main thread
+    // Option: --static-graph wires the listeners downstream of market data
+    // at compile time; by default they are called through ServiceListener
+    // Option: --async runs each service downstream of a connector on a
+    // thread of its own; by default they all run on the main thread
+    // Option: --shards N partitions the products across N shards of the
+    // pipeline running in parallel, sharing the GUI and historical data
+    // Option: --work-stealing N runs a shard per product as a serial queue on
+    // a work-stealing scheduler of N threads. It cannot be set with --shards
+    // Option: --overflow block|drop-oldest|conflate sets what the staged GUI
+    // and historical data listeners do when they fall behind; execution and
+    // position paths always block, so they lose nothing. It cannot be set
+    // with --static-graph, which calls the historical data listeners of the
+    // execution chain directly
+    // Option: --durability buffered|flush|sync sets how far each batch of
+    // historical data is written before the service carries on
+    // Option: --writer write|uring sets how historical data files are
+    // written: with write, or queued on io_uring where the kernel has it
+    // Option: --history-format text|columnar sets the format of the
+    // historical data files; columnar files end in .col
+    // Option: --persistence-thread formats and writes historical data on a
+    // thread of its own; by default it is written by the service persisting it
+    // Option: --reuse-inputs reads the input files left by an earlier run
+    // instead of generating new ones
+    int ingestThreads = 0;
+    bool staticGraph = false;
+    bool async = false;
+    int shardCount = 0;
+    int stealingThreads = 0;
+    OverflowPolicy overflow = BLOCK;
+    DurabilityPolicy durability = BUFFERED;
+    bool persistenceThread = false;
+    WriterBackend writerBackend = WRITE_BACKEND;
+    HistoricalFormat historyFormat = TEXT_FORMAT;
+    bool reuseInputs = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ingest-threads") == 0 && i + 1 < argc) {
+            if (!ParseOptionCount(argv[++i], ingestThreads)) {
+                cerr << "Error: Invalid ingest thread count " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--static-graph") == 0) {
+            staticGraph = true;
+        } else if (strcmp(argv[i], "--async") == 0) {
+            async = true;
+        } else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+            if (!ParseOptionCount(argv[++i], shardCount)) {
+                cerr << "Error: Invalid shard count " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--work-stealing") == 0 && i + 1 < argc) {
+            if (!ParseOptionCount(argv[++i], stealingThreads)) {
+                cerr << "Error: Invalid work-stealing thread count " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--overflow") == 0 && i + 1 < argc) {
+            if (!ParseOverflowPolicy(argv[++i], overflow)) {
+                cerr << "Error: Unknown overflow policy " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--writer") == 0 && i + 1 < argc) {
+            if (!ParseWriterBackend(argv[++i], writerBackend)) {
+                cerr << "Error: Unknown writer backend " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--history-format") == 0 && i + 1 < argc) {
+            if (!ParseHistoricalFormat(argv[++i], historyFormat)) {
+                cerr << "Error: Unknown history format " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--persistence-thread") == 0) {
+            persistenceThread = true;
+        } else if (strcmp(argv[i], "--reuse-inputs") == 0) {
+            reuseInputs = true;
+        } else if (strcmp(argv[i], "--durability") == 0 && i + 1 < argc) {
+            if (!ParseDurabilityPolicy(argv[++i], durability)) {
+                cerr << "Error: Unknown durability policy " << argv[i] << endl;
+                return 1;
+            }
+        } else if (IsValueOption(argv[i])) {
+            // the value is missing at the end of the command line
+            cerr << "Error: Missing value for " << argv[i] << endl;
+            return 1;
+        } else {
+            cerr << "Error: Unknown option " << argv[i] << endl;
+            return 1;
+        }
+    }
+    if (staticGraph && overflow != BLOCK) {
+        cerr << "Error: --overflow cannot be set with --static-graph" << endl;
+        return 1;
+    }
+    if (shardCount > 0 && stealingThreads > 0) {
+        // work stealing runs a shard per product of its own
+        cerr << "Error: --shards cannot be set with --work-stealing" << endl;
+        return 1;
+    }
+    if ((shardCount > 0 || stealingThreads > 0) &&
+        (async || staticGraph || overflow != BLOCK || ingestThreads > 0)) {
+        // the shards wire and feed their own services
+        cerr << "Error: --async, --static-graph, --overflow and "
+                "--ingest-threads cannot be set with --shards or "
+                "--work-stealing"
+             << endl;
+        return 1;
+    }
+
     // Step 1: Generate all the data needed
-    GeneratePrices();
-    GenerateTrades();
-    GenerateInquiries();
-    GenerateMarketData();
-    std::cout << "====== Data Genrated. ======" << std::endl;
+    if (!reuseInputs) {
+        GeneratePrices();
+        GenerateTrades();
+        GenerateInquiries();
+        GenerateMarketData();
+        std::cout << "====== Data Genrated. ======" << std::endl;
+    }
 
     // Step 2: Use Bond as the productType, register all the service
     MarketDataService<Bond> BondMarketDataService;
@@ -48,39 +198,178 @@ int main() {
     HistoricalDataService<ExecutionOrder<Bond>> BondHistoricalExecutionService("Execution");
     HistoricalDataService<PriceStream<Bond>> BondHistoricalStreamingService("Streaming");
     HistoricalDataService<Inquiry<Bond>> BondHistoricalInquiryService("Inquiry");
+    BondHistoricalPositionService.SetDurability(durability);
+    BondHistoricalRiskService.SetDurability(durability);
+    BondHistoricalExecutionService.SetDurability(durability);
+    BondHistoricalStreamingService.SetDurability(durability);
+    BondHistoricalInquiryService.SetDurability(durability);
+    BondHistoricalPositionService.SetWriterBackend(writerBackend);
+    BondHistoricalRiskService.SetWriterBackend(writerBackend);
+    BondHistoricalExecutionService.SetWriterBackend(writerBackend);
+    BondHistoricalStreamingService.SetWriterBackend(writerBackend);
+    BondHistoricalInquiryService.SetWriterBackend(writerBackend);
+    BondHistoricalPositionService.SetFormat(historyFormat);
+    BondHistoricalRiskService.SetFormat(historyFormat);
+    BondHistoricalExecutionService.SetFormat(historyFormat);
+    BondHistoricalStreamingService.SetFormat(historyFormat);
+    BondHistoricalInquiryService.SetFormat(historyFormat);
+    // Declared after the services and before the pipeline, so they persist
+    // what the pipeline drains before the services close their files
+    unique_ptr<PersistenceThread> persistence;
+    unique_ptr<FlushTimer> flushTimer;
+    if (persistenceThread) {
+        persistence.reset(new PersistenceThread());
+        BondHistoricalPositionService.SetPersistenceThread(persistence.get());
+        BondHistoricalRiskService.SetPersistenceThread(persistence.get());
+        BondHistoricalExecutionService.SetPersistenceThread(persistence.get());
+        BondHistoricalStreamingService.SetPersistenceThread(persistence.get());
+        BondHistoricalInquiryService.SetPersistenceThread(persistence.get());
+    } else if (durability == BUFFERED) {
+        // buffered files are written on time, not only as records come in
+        flushTimer.reset(new FlushTimer());
+        BondHistoricalPositionService.SetFlushTimer(flushTimer.get());
+        BondHistoricalRiskService.SetFlushTimer(flushTimer.get());
+        BondHistoricalExecutionService.SetFlushTimer(flushTimer.get());
+        BondHistoricalStreamingService.SetFlushTimer(flushTimer.get());
+        BondHistoricalInquiryService.SetFlushTimer(flushTimer.get());
+    }
     std::cout << "====== Services initialized! ======\n";
 
     // Step 3: Link corresponding service
+    // Staged listeners run on their own thread when the pipeline is enabled
+    AsyncPipeline pipeline(async);
 
-    BondPricingService.AddListener(BondGUIService.GetListener());
-    BondPricingService.AddListener(BondAlgoStreamingService.GetListener());
-    BondAlgoStreamingService.AddListener(BondStreamingService.GetListener());
-    BondStreamingService.AddListener(
-        BondHistoricalStreamingService.GetServiceListener());
-    BondMarketDataService.AddListener(BondAlgoExecutionService.GetListener());
-    BondAlgoExecutionService.AddListener(BondExecutionService.GetListener());
+    // Fan-outs share one event ring, read in place by each listener; a
+    // listener allowed to drop events reads it through a stage of its own
+    ServiceListener<Price<Bond>>* guiListener = BondGUIService.GetListener();
+    if (overflow != BLOCK) {
+        guiListener = pipeline.Stage<Price<Bond>>(guiListener, overflow,
+                                                  GetProductKey<Price<Bond>>);
+    }
+    for (auto& l : Broadcast<Price<Bond>>(
+             pipeline,
+             {guiListener, BondAlgoStreamingService.GetListener()})) {
+        BondPricingService.AddListener(l);
+    }
+    BondAlgoStreamingService.AddListener(
+        pipeline.Stage(BondStreamingService.GetListener()));
+    BondStreamingService.AddListener(pipeline.Stage<PriceStream<Bond>>(
+        BondHistoricalStreamingService.GetServiceListener(), overflow,
+        GetProductKey<PriceStream<Bond>>));
+    // the same chain from market data to historical data, wired statically
+    auto executionGraph = Wire(
+        BondAlgoExecutionService.GetListener(),
+        Wire(BondExecutionService.GetListener(),
+             Wire(BondHistoricalExecutionService.GetServiceListener()),
+             Wire(BondTradeBookingService.GetListener(),
+                  Wire(BondPositionService.GetListener(),
+                       Wire(BondRiskService.GetListener(),
+                            Wire(BondHistoricalRiskService
+                                     .GetServiceListener())),
+                       Wire(BondHistoricalPositionService
+                                .GetServiceListener())))));
+    StaticListener<OrderBook<Bond>, decltype(executionGraph)>
+        executionListener(executionGraph);
+    if (staticGraph) {
+        BondMarketDataService.AddListener(pipeline.Stage(&executionListener));
+    } else {
+        BondMarketDataService.AddListener(
+            pipeline.Stage(BondAlgoExecutionService.GetListener()));
+    }
+    BondAlgoExecutionService.AddListener(
+        pipeline.Stage(BondExecutionService.GetListener()));
+    BondExecutionService.AddListener(
+        pipeline.Stage<ExecutionOrder<Bond>, string>(
+            BondHistoricalExecutionService.GetServiceListener(), overflow,
+            GetOrderKey<ExecutionOrder<Bond>>));
     BondExecutionService.AddListener(
-        BondHistoricalExecutionService.GetServiceListener());
-    BondExecutionService.AddListener(BondTradeBookingService.GetListener());
-    BondTradeBookingService.AddListener(BondPositionService.GetListener());
-    BondPositionService.AddListener(BondRiskService.GetListener());
-    BondPositionService.AddListener(
-        BondHistoricalPositionService.GetServiceListener());
-    BondRiskService.AddListener(BondHistoricalRiskService.GetServiceListener());
-    BondInquiryService.AddListener(
-        BondHistoricalInquiryService.GetServiceListener());
+        pipeline.Stage(BondTradeBookingService.GetListener()));
+    BondTradeBookingService.AddListener(
+        pipeline.Stage(BondPositionService.GetListener()));
+    ServiceListener<Position<Bond>>* historicalPositionListener =
+        BondHistoricalPositionService.GetServiceListener();
+    if (overflow != BLOCK) {
+        historicalPositionListener = pipeline.Stage<Position<Bond>>(
+            historicalPositionListener, overflow,
+            GetProductKey<Position<Bond>>);
+    }
+    for (auto& l : Broadcast<Position<Bond>>(
+             pipeline,
+             {BondRiskService.GetListener(), historicalPositionListener})) {
+        BondPositionService.AddListener(l);
+    }
+    BondRiskService.AddListener(pipeline.Stage<PV01<Bond>>(
+        BondHistoricalRiskService.GetServiceListener(), overflow,
+        GetProductKey<PV01<Bond>>));
+    BondInquiryService.AddListener(pipeline.Stage<Inquiry<Bond>, string>(
+        BondHistoricalInquiryService.GetServiceListener(), overflow,
+        GetInquiryKey<Inquiry<Bond>>));
     std::cout << "====== Services linked. ======" << std::endl;
 
     // Step 4: Read data and write to output
+    // The input files are memory mapped and read without copying lines
     const string dirPath = "Data/Input/";
-    ifstream priceData(dirPath + "prices.txt");
-    BondPricingService.GetConnector()->Subscribe(priceData);
-    ifstream marketData(dirPath + "marketdata.txt");
-    BondMarketDataService.GetConnector()->Subscribe(marketData);
-    ifstream tradeData(dirPath + "trades.txt");
-    BondTradeBookingService.GetConnector()->Subscribe(tradeData);
-    ifstream inquiryData(dirPath + "inquiries.txt");
-    BondInquiryService.GetConnector()->Subscribe(inquiryData);
+    MappedFile priceData(dirPath + "prices.txt");
+    MappedFile marketData(dirPath + "marketdata.txt");
+    MappedFile tradeData(dirPath + "trades.txt");
+    MappedFile inquiryData(dirPath + "inquiries.txt");
+    // levels dropped by full order books, in the shards when sharded
+    long droppedLevels = 0;
+    if (shardCount > 0 || stealingThreads > 0) {
+        // each shard owns its products' services, merging into the shared
+        // GUI and historical data services
+        unique_ptr<WorkStealingScheduler> scheduler;
+        if (stealingThreads > 0) {
+            scheduler.reset(new WorkStealingScheduler(stealingThreads));
+            shardCount = GetProductRegistry<Bond>().GetSize();
+        }
+        ShardedRuntime<Bond> runtime(
+            shardCount, BondGUIService.GetListener(),
+            BondHistoricalStreamingService.GetServiceListener(),
+            BondHistoricalExecutionService.GetServiceListener(),
+            BondHistoricalPositionService.GetServiceListener(),
+            BondHistoricalRiskService.GetServiceListener(),
+            BondHistoricalInquiryService.GetServiceListener(),
+            scheduler.get());
+        runtime.Subscribe(priceData, PRICE_FEED);
+        runtime.Subscribe(marketData, MARKET_DATA_FEED);
+        runtime.Subscribe(tradeData, TRADE_FEED);
+        runtime.Subscribe(inquiryData, INQUIRY_FEED);
+        runtime.Drain();
+        droppedLevels = runtime.GetDroppedLevels();
+    } else {
+        if (ingestThreads > 0) {
+            // chunks are parsed in parallel and applied in file order
+            ThreadPool ingestPool(ingestThreads);
+            BondPricingService.GetConnector()->Subscribe(priceData,
+                                                         ingestPool);
+            BondMarketDataService.GetConnector()->Subscribe(marketData,
+                                                            ingestPool);
+        } else {
+            LineSource priceLines(priceData);
+            BondPricingService.GetConnector()->Subscribe(priceLines);
+            LineSource marketLines(marketData);
+            BondMarketDataService.GetConnector()->Subscribe(marketLines);
+        }
+        // executions are booked before the trades from file, and the main
+        // thread takes over from the booking stage as producer for positions
+        pipeline.Drain();
+        LineSource tradeLines(tradeData);
+        BondTradeBookingService.GetConnector()->Subscribe(tradeLines);
+        LineSource inquiryLines(inquiryData);
+        BondInquiryService.GetConnector()->Subscribe(inquiryLines);
+        pipeline.Drain();
+        droppedLevels = BondMarketDataService.GetDroppedLevels();
+    }
+    if (droppedLevels > 0) {
+        std::cout << "====== " << droppedLevels
+                  << " price levels dropped by full order books ======"
+                  << std::endl;
+    }
+    if (pipeline.GetDropped() > 0) {
+        std::cout << "====== " << pipeline.GetDropped()
+                  << " events dropped by slow listeners ======" << std::endl;
+    }
     std::cout << "====== All Finished! ======" << std::endl;
 
     return 0;
@@ -0,0 +1,254 @@
+/**
+ * mappedfile.hpp
+ * Defines a memory mapped input file and a zero-copy line source over it.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include "csvtokenizer.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+/**
+ * A read-only memory mapping of a whole file.
+ */
+class MappedFile {
+
+  public:
+    // ctor mapping the file at the path
+    MappedFile(const string& _path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Check whether the file could be opened
+    bool IsOpen() const;
+
+    // Get the start of the mapped bytes
+    const char* GetData() const;
+
+    // Get the number of mapped bytes
+    size_t GetSize() const;
+
+  private:
+    const char* data;
+    size_t size;
+    bool isOpen;
+};
+
+// Bytes tokenized at a time by a LineSource
+constexpr size_t LINE_SOURCE_WINDOW = 1 << 20;
+
+/**
+ * Source of input lines as string_views into a buffer, usually a mapped
+ * file. The views stay valid as long as the buffer does.
+ * Separators are found by the vectorized CSV tokenizer one window of whole
+ * lines at a time, so memory use does not grow with the file.
+ */
+class LineSource {
+
+  public:
+    // ctor over a range of bytes
+    LineSource(const char* _begin, const char* _end);
+
+    // ctor over a whole mapped file
+    LineSource(const MappedFile& _file);
+
+    // Get the next line without its newline, false when none are left.
+    // A '\r' before the newline (CRLF input) is dropped as well.
+    bool GetLine(string_view& _line);
+
+    // Split the next line on ',' into at most _maxFields views, dropping a
+    // '\r' before the newline from the last field.
+    // Returns the number of fields stored, or -1 when no lines are left.
+    int GetFields(string_view* _fields, int _maxFields);
+
+  private:
+    // Tokenize the next window of whole lines, false at the end
+    bool NextWindow();
+
+    // Get the end of the text from _start to a newline at _newline, before
+    // the '\r' of a CRLF line end
+    uint32_t TrimCarriageReturn(uint32_t _start, uint32_t _newline) const;
+
+    const char* current;
+    const char* end;
+    const char* window;
+    vector<uint32_t> separators;
+    size_t separatorIndex;
+    uint32_t lineStart;
+};
+
+// Split a line on ',' into at most _maxFields views, returns the count.
+// A trailing '\r' left by getline on CRLF input is dropped.
+int SplitFields(string_view _line, string_view* _fields, int _maxFields) {
+    if (!_line.empty() && _line.back() == '\r') {
+        _line.remove_suffix(1);
+    }
+    int _count = 0;
+    size_t _start = 0;
+    while (_count < _maxFields) {
+        size_t _comma = _line.find(',', _start);
+        if (_comma == string_view::npos) {
+            _fields[_count++] = _line.substr(_start);
+            break;
+        }
+        _fields[_count++] = _line.substr(_start, _comma - _start);
+        _start = _comma + 1;
+    }
+    return _count;
+}
+
+MappedFile::MappedFile(const string& _path)
+    : data(nullptr), size(0), isOpen(false) {
+    int _fd = open(_path.c_str(), O_RDONLY);
+    if (_fd < 0) {
+        cerr << "Error: Unable to open file at " << _path << endl;
+        return;
+    }
+
+    struct stat _stat;
+    if (fstat(_fd, &_stat) == 0 && _stat.st_size > 0) {
+        void* _map = mmap(nullptr, _stat.st_size, PROT_READ, MAP_PRIVATE, _fd, 0);
+        if (_map == MAP_FAILED) {
+            cerr << "Error: Unable to map file at " << _path << endl;
+            close(_fd);
+            return;
+        }
+        // the whole file is read front to back once
+        madvise(_map, _stat.st_size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(_map);
+        size = _stat.st_size;
+    }
+    close(_fd);
+    isOpen = true;
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+bool MappedFile::IsOpen() const { return isOpen; }
+
+const char* MappedFile::GetData() const { return data; }
+
+size_t MappedFile::GetSize() const { return size; }
+
+LineSource::LineSource(const char* _begin, const char* _end)
+    : current(_begin), end(_end), window(_begin), separatorIndex(0),
+      lineStart(0) {}
+
+LineSource::LineSource(const MappedFile& _file)
+    : LineSource(_file.GetData(), _file.GetData() + _file.GetSize()) {}
+
+bool LineSource::NextWindow() {
+    if (current == end) {
+        return false;
+    }
+
+    // end the window after the last newline it holds, or stretch it to the
+    // end of a line longer than the window
+    const char* _windowEnd = end;
+    if (static_cast<size_t>(end - current) > LINE_SOURCE_WINDOW) {
+        _windowEnd = current + LINE_SOURCE_WINDOW;
+        const char* _newline = nullptr;
+        for (const char* p = _windowEnd - 1; p >= current; p--) {
+            if (*p == '\n') {
+                _newline = p;
+                break;
+            }
+        }
+        if (_newline == nullptr) {
+            _newline = static_cast<const char*>(
+                memchr(_windowEnd, '\n', end - _windowEnd));
+        }
+        _windowEnd = _newline != nullptr ? _newline + 1 : end;
+    }
+
+    separators.clear();
+    separatorIndex = 0;
+    lineStart = 0;
+    window = current;
+    if (!TokenizeCsv(window, _windowEnd, separators)) {
+        cerr << "Error: Input line is too long to tokenize" << endl;
+        current = end;
+        return false;
+    }
+
+    // a last line without a newline still ends there
+    if (_windowEnd[-1] != '\n') {
+        separators.push_back(static_cast<uint32_t>(_windowEnd - window) |
+                             CSV_NEWLINE_FLAG);
+    }
+    current = _windowEnd;
+    return true;
+}
+
+uint32_t LineSource::TrimCarriageReturn(uint32_t _start,
+                                        uint32_t _newline) const {
+    return _newline > _start && window[_newline - 1] == '\r' ? _newline - 1
+                                                               : _newline;
+}
+
+bool LineSource::GetLine(string_view& _line) {
+    while (separatorIndex == separators.size()) {
+        if (!NextWindow()) {
+            return false;
+        }
+    }
+
+    // skip the commas up to the newline
+    uint32_t _separator = separators[separatorIndex++];
+    while (!(_separator & CSV_NEWLINE_FLAG)) {
+        _separator = separators[separatorIndex++];
+    }
+    uint32_t _lineEnd = _separator & ~CSV_NEWLINE_FLAG;
+    uint32_t _textEnd = TrimCarriageReturn(lineStart, _lineEnd);
+    _line = string_view(window + lineStart, _textEnd - lineStart);
+    lineStart = _lineEnd + 1;
+    return true;
+}
+
+int LineSource::GetFields(string_view* _fields, int _maxFields) {
+    while (separatorIndex == separators.size()) {
+        if (!NextWindow()) {
+            return -1;
+        }
+    }
+
+    int _count = 0;
+    uint32_t _fieldStart = lineStart;
+    while (true) {
+        uint32_t _separator = separators[separatorIndex++];
+        uint32_t _position = _separator & ~CSV_NEWLINE_FLAG;
+        uint32_t _fieldEnd = _separator & CSV_NEWLINE_FLAG
+                                 ? TrimCarriageReturn(_fieldStart, _position)
+                                 : _position;
+        if (_count < _maxFields) {
+            _fields[_count++] =
+                string_view(window + _fieldStart, _fieldEnd - _fieldStart);
+        }
+        _fieldStart = _position + 1;
+        if (_separator & CSV_NEWLINE_FLAG) {
+            break;
+        }
+    }
+    lineStart = _fieldStart;
+    return _count;
+}
+
+#endif
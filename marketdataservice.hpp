@@ -8,10 +8,10 @@
 #ifndef MARKET_DATA_SERVICE_HPP
 #define MARKET_DATA_SERVICE_HPP
 
+#include "parallelingest.hpp"
 #include "soa.hpp"
 #include "utility.hpp"
 #include <string>
-#include <unordered_map>
 #include <vector>
 using namespace std;
 
@@ -25,11 +25,11 @@ class Order {
 
   public:
     // ctor for an order
-    Order(double _price, long _quantity, PricingSide _side);
+    Order(TickPrice _price, long _quantity, PricingSide _side);
     Order() = default;
 
     // Get the price on the order
-    double GetPrice() const;
+    TickPrice GetPrice() const;
 
     // Get the quantity on the order
     long GetQuantity() const;
@@ -38,7 +38,7 @@ class Order {
     PricingSide GetSide() const;
 
   private:
-    double price;
+    TickPrice price;
     long quantity;
     PricingSide side;
 };
@@ -64,6 +64,59 @@ class BidOffer {
     Order offerOrder;
 };
 
+// Maximum number of price levels held on each side of an order book.
+// The feed sends GetOrderBookDepth() / 2 levels a side, well within it. A
+// book holding more drops its worst levels for good: they do not come back
+// when better levels are deleted, so the book is shallower than the feed.
+// Dropped levels are counted, see OrderBook::GetDroppedLevels.
+constexpr int ORDER_BOOK_CAPACITY = 32;
+
+/**
+ * Fixed-capacity stack of price levels on one side of a book.
+ * Levels are kept sorted best first, so the top of book sits at index 0.
+ * When the stack is full the worst level is dropped and counted.
+ */
+class OrderStack {
+
+  public:
+    // ctor for a stack on the given side
+    OrderStack(PricingSide _side);
+
+    // Get the number of levels
+    int GetSize() const;
+
+    // Get the level at the given index, 0 is the best one
+    const Order& operator[](int _index) const;
+
+    // Iterate over the levels, best first
+    const Order* begin() const;
+    const Order* end() const;
+
+    // Add, modify or delete (zero quantity) the level of the order price.
+    // Returns the index that was touched, or -1 if the stack is unchanged.
+    // _onChange(price, quantity change, side) is told about every level
+    // whose quantity changed, including a worst level dropped when full.
+    template <typename F>
+    int Update(const Order& _order, long _cycle, F _onChange);
+
+    // Delete the levels which were not refreshed in the given cycle.
+    // Returns true if the best level changed.
+    template <typename F> bool RemoveStale(long _cycle, F _onChange);
+
+    // Get the number of levels dropped because the stack was full
+    long GetDropped() const;
+
+  private:
+    // Whether price a ranks ahead of price b on this side
+    bool IsBetter(TickPrice a, TickPrice b) const;
+
+    Order orders[ORDER_BOOK_CAPACITY];
+    long cycles[ORDER_BOOK_CAPACITY];
+    int size;
+    PricingSide side;
+    long dropped;
+};
+
 /**
  * Order book with a bid and offer stack.
  * Type T is the product type.
@@ -73,25 +126,93 @@ template <typename T> class OrderBook {
   public:
     // ctor for the order book
     OrderBook() = default;
-    OrderBook(const T& _product, const vector<Order>& _bidStack,
+    OrderBook(ProductHandle<T> _product, const vector<Order>& _bidStack,
               const vector<Order>& _offerStack);
 
     // Get the product
     const T& GetProduct() const;
 
+    // Get the handle of the product
+    ProductHandle<T> GetProductHandle() const;
+
     // Get the bid stack
-    const vector<Order>& GetBidStack() const;
+    const OrderStack& GetBidStack() const;
 
     // Get the offer stack
-    const vector<Order>& GetOfferStack() const;
+    const OrderStack& GetOfferStack() const;
 
     // Get the best bid/offer order (the ones at the top)
-    const BidOffer GetBidOffer() const;
+    const BidOffer& GetBidOffer() const;
+
+    // Apply a price level update in place: a new price adds a level, a known
+    // price modifies its quantity and a zero quantity deletes the level
+    void UpdateOrder(const Order& _order);
+    template <typename F> void UpdateOrder(const Order& _order, F _onChange);
+
+    // Delete the levels which were not refreshed since the last call
+    void RemoveStaleOrders();
+    template <typename F> void RemoveStaleOrders(F _onChange);
+
+    // Get the number of levels dropped on both sides because their stack
+    // was full
+    long GetDroppedLevels() const;
+
+  private:
+    // Refresh the cached best bid/offer from the top of both stacks
+    void UpdateBidOffer();
+
+    ProductHandle<T> product;
+    OrderStack bidStack{BID};
+    OrderStack offerStack{OFFER};
+    BidOffer bidOffer;
+    long updateCycle = 0;
+};
+
+// Number of 1/256 ticks held in the flat window of aggregated depth
+constexpr int DEPTH_WINDOW_TICKS = 512;
+
+/**
+ * Depth aggregation engine of one product.
+ * Quantities are summed per integer 1/256 tick in flat arrays covering a
+ * window around the touch; ticks outside the window spill into a map, and
+ * the window only recentres when the touch moves out of it, so far levels
+ * never move it. The aggregated
+ * order book is maintained from level changes as they arrive. It shows the
+ * best ORDER_BOOK_CAPACITY levels a side; the window and maps hold every
+ * level, and refill the book when it loses one of them.
+ * Type T is the product type.
+ */
+template <typename T> class DepthAggregator {
+
+  public:
+    // ctor seeding the aggregation from the current book
+    DepthAggregator(const OrderBook<T>& _book);
+
+    // Add a quantity change at a price on a side
+    void Add(TickPrice _price, long _quantity, PricingSide _side);
+
+    // Get the aggregated order book
+    const OrderBook<T>& GetOrderBook() const;
 
   private:
-    T product;
-    vector<Order> bidStack;
-    vector<Order> offerStack;
+    // Move the window so that it is centred on the tick
+    void Recenter(long _tick);
+
+    // Get the tick of the touch, the best bid or else the best offer, false
+    // if the book is empty
+    bool GetTouch(long& _tick) const;
+
+    // Add the best level beyond the worst one shown on a side of the
+    // aggregated book, once a level deleted from the full side leaves room
+    void Refill(PricingSide _side);
+
+    OrderBook<T> aggregatedBook;
+    long bidDepth[DEPTH_WINDOW_TICKS];
+    long offerDepth[DEPTH_WINDOW_TICKS];
+    map<long, long> bidOverflow;
+    map<long, long> offerOverflow;
+    long baseTick;
+    bool centred;
 };
 
 // Pre-declaration of connector
@@ -99,11 +220,11 @@ template <typename T> class MarketDataConnector;
 
 /**
  * Market Data Service which distributes market data
- * Keyed on product identifier.
+ * Keyed on product CUSIP, held by product index.
  * Type T is the product type.
  */
 template <typename T>
-class MarketDataService : public Service<string, OrderBook<T>> {
+class MarketDataService : public Service<Cusip, OrderBook<T>> {
   public:
     // ctor
     MarketDataService();
@@ -111,7 +232,7 @@ class MarketDataService : public Service<string, OrderBook<T>> {
     ~MarketDataService();
 
     // Get data on our service given product id
-    OrderBook<T>& GetData(string _key);
+    OrderBook<T>& GetData(Cusip _key);
 
     // Call back function that a Connector should invoke for any new or updated
     // data
@@ -130,13 +251,28 @@ class MarketDataService : public Service<string, OrderBook<T>> {
     int GetOrderBookDepth() const;
 
     // Get the best bid/offer order
-    const BidOffer GetBestBidOffer(const string& productId);
+    const BidOffer& GetBestBidOffer(const Cusip& productId);
 
     // Aggregate the order book
-    const OrderBook<T>& AggregateDepth(const string& productId);
+    const OrderBook<T>& AggregateDepth(const Cusip& productId);
+
+    // Apply a price level update to the live order book of a product
+    OrderBook<T>& UpdateOrderBook(ProductIndex _index, const Order& _order);
+    OrderBook<T>& UpdateOrderBook(const Cusip& _productId,
+                                  const Order& _order);
+
+    // Delete the levels of the live order book of a product which were not
+    // refreshed in the current round of updates
+    void RemoveStaleOrders(ProductIndex _index);
+    void RemoveStaleOrders(const Cusip& _productId);
+
+    // Get the number of levels dropped by the live order books because
+    // they were full
+    long GetDroppedLevels() const;
 
   private:
-    map<string, OrderBook<T>> orderBooks;
+    ProductTable<OrderBook<T>> orderBooks;
+    ProductTable<DepthAggregator<T>> depths;
     vector<ServiceListener<OrderBook<T>>*> listeners;
     MarketDataConnector<T>* connector;
     int bookDepth;
@@ -158,17 +294,45 @@ class MarketDataConnector : public Connector<OrderBook<T>> {
     // Subscribe Data from the Connector
     void Subscribe(ifstream& data);
 
+    // Subscribe data from lines of a memory mapped source
+    void Subscribe(LineSource& _data);
+
+    // Subscribe data from a memory mapped file, parsing chunks of it on the
+    // pool and applying the level updates to the service in file order
+    void Subscribe(const MappedFile& _data, ThreadPool& _pool);
+
+    // Set whether the orders added are counted into rounds per product
+    void SetCountPerProduct(bool _perProduct);
+
   private:
+    // A level update parsed from one line
+    struct LevelUpdate {
+        ProductIndex product;
+        Order order;
+    };
+
+    // Parse the fields of one line into a level update, false if it is
+    // invalid. Safe to call from several threads.
+    bool ParseFields(const string_view* vecs, int _count,
+                     LevelUpdate& _update) const;
+
+    // Apply a level update to the live book, publishing it after each round
+    void ApplyUpdate(const LevelUpdate& _update);
+
+    // Parse the fields of one line and apply the level update to the service
+    void ProcessFields(const string_view* vecs, int _count);
+
     MarketDataService<T>* service;
+    ProductCounter orderCount; // keep track of total orders added
 };
 
-Order::Order(double _price, long _quantity, PricingSide _side) {
+Order::Order(TickPrice _price, long _quantity, PricingSide _side) {
     price = _price;
     quantity = _quantity;
     side = _side;
 }
 
-double Order::GetPrice() const { return price; }
+TickPrice Order::GetPrice() const { return price; }
 
 long Order::GetQuantity() const { return quantity; }
 
@@ -181,50 +345,312 @@ const Order& BidOffer::GetBidOrder() const { return bidOrder; }
 
 const Order& BidOffer::GetOfferOrder() const { return offerOrder; }
 
+OrderStack::OrderStack(PricingSide _side)
+    : size(0), side(_side), dropped(0) {}
+
+int OrderStack::GetSize() const { return size; }
+
+const Order& OrderStack::operator[](int _index) const {
+    return orders[_index];
+}
+
+const Order* OrderStack::begin() const { return orders; }
+
+const Order* OrderStack::end() const { return orders + size; }
+
+bool OrderStack::IsBetter(TickPrice a, TickPrice b) const {
+    return side == BID ? a > b : a < b;
+}
+
+template <typename F>
+int OrderStack::Update(const Order& _order, long _cycle, F _onChange) {
+    TickPrice _price = _order.GetPrice();
+
+    // levels are sorted, stop at the first one not ahead of the price
+    int i = 0;
+    while (i < size && IsBetter(orders[i].GetPrice(), _price)) {
+        i++;
+    }
+
+    if (i < size && orders[i].GetPrice() == _price) {
+        _onChange(_price, _order.GetQuantity() - orders[i].GetQuantity(), side);
+        if (_order.GetQuantity() == 0) {
+            // delete the level
+            for (int j = i + 1; j < size; j++) {
+                orders[j - 1] = orders[j];
+                cycles[j - 1] = cycles[j];
+            }
+            size--;
+        } else {
+            // modify the level
+            orders[i] = _order;
+            cycles[i] = _cycle;
+        }
+        return i;
+    }
+
+    // add a new level, dropping the worst one when full
+    if (_order.GetQuantity() == 0) {
+        return -1;
+    }
+    if (i == ORDER_BOOK_CAPACITY) {
+        // worse than every level of a full stack
+        dropped++;
+        return -1;
+    }
+    if (size == ORDER_BOOK_CAPACITY) {
+        const Order& _worst = orders[size - 1];
+        _onChange(_worst.GetPrice(), -_worst.GetQuantity(), side);
+        size--;
+        dropped++;
+    }
+    for (int j = size; j > i; j--) {
+        orders[j] = orders[j - 1];
+        cycles[j] = cycles[j - 1];
+    }
+    orders[i] = _order;
+    cycles[i] = _cycle;
+    size++;
+    _onChange(_price, _order.GetQuantity(), side);
+    return i;
+}
+
+template <typename F> bool OrderStack::RemoveStale(long _cycle, F _onChange) {
+    bool _topChanged = size > 0 && cycles[0] != _cycle;
+    int _count = 0;
+    for (int i = 0; i < size; i++) {
+        if (cycles[i] == _cycle) {
+            orders[_count] = orders[i];
+            cycles[_count++] = _cycle;
+        } else {
+            _onChange(orders[i].GetPrice(), -orders[i].GetQuantity(), side);
+        }
+    }
+    size = _count;
+    return _topChanged;
+}
+
+long OrderStack::GetDropped() const { return dropped; }
+
 template <typename T>
-OrderBook<T>::OrderBook(const T& _product, const vector<Order>& _bidStack,
+OrderBook<T>::OrderBook(ProductHandle<T> _product,
+                        const vector<Order>& _bidStack,
                         const vector<Order>& _offerStack)
-    : product(_product), bidStack(_bidStack), offerStack(_offerStack) {}
+    : product(_product) {
+    for (auto& _order : _bidStack) {
+        UpdateOrder(_order);
+    }
+    for (auto& _order : _offerStack) {
+        UpdateOrder(_order);
+    }
+    UpdateBidOffer();
+}
 
 template <typename T> const T& OrderBook<T>::GetProduct() const {
+    return product.Get();
+}
+
+template <typename T>
+ProductHandle<T> OrderBook<T>::GetProductHandle() const {
     return product;
 }
 
-template <typename T> const vector<Order>& OrderBook<T>::GetBidStack() const {
+template <typename T> const OrderStack& OrderBook<T>::GetBidStack() const {
     return bidStack;
 }
 
-template <typename T> const vector<Order>& OrderBook<T>::GetOfferStack() const {
+template <typename T> const OrderStack& OrderBook<T>::GetOfferStack() const {
     return offerStack;
 }
 
-// Get the highest bid, lowest offer
-template <typename T> const BidOffer OrderBook<T>::GetBidOffer() const {
-    Order highest_bid(bidStack[0]);
-    double h_bid_price = highest_bid.GetPrice();
-    for (auto i = 1; i < bidStack.size(); i++) {
-        Order curr_bid = bidStack[i];
-        if (curr_bid.GetPrice() > h_bid_price) {
-            highest_bid = curr_bid;
-            h_bid_price = highest_bid.GetPrice();
+// Get the highest bid, lowest offer, cached between updates
+template <typename T> const BidOffer& OrderBook<T>::GetBidOffer() const {
+    return bidOffer;
+}
+
+template <typename T> void OrderBook<T>::UpdateBidOffer() {
+    Order _bid =
+        bidStack.GetSize() > 0 ? bidStack[0] : Order(TickPrice(), 0, BID);
+    Order _offer = offerStack.GetSize() > 0 ? offerStack[0]
+                                            : Order(TickPrice(), 0, OFFER);
+    bidOffer = BidOffer(_bid, _offer);
+}
+
+template <typename T> void OrderBook<T>::UpdateOrder(const Order& _order) {
+    UpdateOrder(_order, [](TickPrice, long, PricingSide) {});
+}
+
+template <typename T>
+template <typename F>
+void OrderBook<T>::UpdateOrder(const Order& _order, F _onChange) {
+    OrderStack& _stack = _order.GetSide() == BID ? bidStack : offerStack;
+    if (_stack.Update(_order, updateCycle, _onChange) == 0) {
+        UpdateBidOffer();
+    }
+}
+
+template <typename T> void OrderBook<T>::RemoveStaleOrders() {
+    RemoveStaleOrders([](TickPrice, long, PricingSide) {});
+}
+
+template <typename T>
+template <typename F>
+void OrderBook<T>::RemoveStaleOrders(F _onChange) {
+    bool _bidChanged = bidStack.RemoveStale(updateCycle, _onChange);
+    bool _offerChanged = offerStack.RemoveStale(updateCycle, _onChange);
+    if (_bidChanged || _offerChanged) {
+        UpdateBidOffer();
+    }
+    updateCycle++;
+}
+
+template <typename T> long OrderBook<T>::GetDroppedLevels() const {
+    return bidStack.GetDropped() + offerStack.GetDropped();
+}
+
+template <typename T>
+DepthAggregator<T>::DepthAggregator(const OrderBook<T>& _book)
+    : aggregatedBook(_book.GetProductHandle(), vector<Order>(),
+                     vector<Order>()),
+      bidDepth(), offerDepth(), baseTick(0), centred(false) {
+    for (auto& _order : _book.GetBidStack()) {
+        Add(_order.GetPrice(), _order.GetQuantity(), BID);
+    }
+    for (auto& _order : _book.GetOfferStack()) {
+        Add(_order.GetPrice(), _order.GetQuantity(), OFFER);
+    }
+}
+
+template <typename T>
+void DepthAggregator<T>::Add(TickPrice _price, long _quantity,
+                             PricingSide _side) {
+    long _tick = _price.GetTicks();
+    if (!centred) {
+        Recenter(_tick);
+    }
+
+    long _total;
+    if (_tick >= baseTick && _tick < baseTick + DEPTH_WINDOW_TICKS) {
+        long* _depth = _side == BID ? bidDepth : offerDepth;
+        _total = _depth[_tick - baseTick] += _quantity;
+    } else {
+        // far levels spill into the map instead of moving the window
+        map<long, long>& _overflow = _side == BID ? bidOverflow : offerOverflow;
+        _total = _overflow[_tick] += _quantity;
+        if (_total == 0) {
+            _overflow.erase(_tick);
+        }
+    }
+
+    // a level aggregated down to zero quantity is deleted
+    aggregatedBook.UpdateOrder(Order(_price, _total, _side));
+    if (_total == 0) {
+        Refill(_side);
+    }
+
+    // the window only follows the touch
+    long _touch;
+    if (GetTouch(_touch) &&
+        (_touch < baseTick || _touch >= baseTick + DEPTH_WINDOW_TICKS)) {
+        Recenter(_touch);
+    }
+}
+
+template <typename T>
+const OrderBook<T>& DepthAggregator<T>::GetOrderBook() const {
+    return aggregatedBook;
+}
+
+template <typename T> void DepthAggregator<T>::Recenter(long _tick) {
+    // spill the whole window, then pull back what the new window covers
+    for (int i = 0; centred && i < DEPTH_WINDOW_TICKS; i++) {
+        if (bidDepth[i] != 0) {
+            bidOverflow[baseTick + i] = bidDepth[i];
         }
+        if (offerDepth[i] != 0) {
+            offerOverflow[baseTick + i] = offerDepth[i];
+        }
+        bidDepth[i] = 0;
+        offerDepth[i] = 0;
+    }
+    baseTick = _tick - DEPTH_WINDOW_TICKS / 2;
+    centred = true;
+
+    long _endTick = baseTick + DEPTH_WINDOW_TICKS;
+    auto it = bidOverflow.lower_bound(baseTick);
+    while (it != bidOverflow.end() && it->first < _endTick) {
+        bidDepth[it->first - baseTick] = it->second;
+        it = bidOverflow.erase(it);
+    }
+    it = offerOverflow.lower_bound(baseTick);
+    while (it != offerOverflow.end() && it->first < _endTick) {
+        offerDepth[it->first - baseTick] = it->second;
+        it = offerOverflow.erase(it);
+    }
+}
+
+template <typename T> bool DepthAggregator<T>::GetTouch(long& _tick) const {
+    const BidOffer& _bidOffer = aggregatedBook.GetBidOffer();
+    if (aggregatedBook.GetBidStack().GetSize() > 0) {
+        _tick = _bidOffer.GetBidOrder().GetPrice().GetTicks();
+    } else if (aggregatedBook.GetOfferStack().GetSize() > 0) {
+        _tick = _bidOffer.GetOfferOrder().GetPrice().GetTicks();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+template <typename T> void DepthAggregator<T>::Refill(PricingSide _side) {
+    const OrderStack& _stack = _side == BID ? aggregatedBook.GetBidStack()
+                                            : aggregatedBook.GetOfferStack();
+    // only a side which was full can have levels beyond the ones shown
+    if (_stack.GetSize() != ORDER_BOOK_CAPACITY - 1) {
+        return;
     }
 
-    Order lowest_offer(offerStack[0]);
-    double l_offer_price = lowest_offer.GetPrice();
-    for (auto i = 1; i < offerStack.size(); i++) {
-        Order curr_offer = offerStack[i];
-        if (curr_offer.GetPrice() < l_offer_price) {
-            lowest_offer = curr_offer;
-            l_offer_price = lowest_offer.GetPrice();
+    long _worst = _stack[_stack.GetSize() - 1].GetPrice().GetTicks();
+    long _endTick = baseTick + DEPTH_WINDOW_TICKS;
+    long _tick = 0;
+    long _quantity = 0;
+    if (_side == BID) {
+        // the highest bid below the worst one, in the window or the map
+        for (long t = min(_worst - 1, _endTick - 1); t >= baseTick; t--) {
+            if (bidDepth[t - baseTick] != 0) {
+                _tick = t;
+                _quantity = bidDepth[t - baseTick];
+                break;
+            }
+        }
+        auto it = bidOverflow.lower_bound(_worst);
+        if (it != bidOverflow.begin() &&
+            (_quantity == 0 || prev(it)->first > _tick)) {
+            _tick = prev(it)->first;
+            _quantity = prev(it)->second;
+        }
+    } else {
+        // the lowest offer above the worst one, in the window or the map
+        for (long t = max(_worst + 1, baseTick); t < _endTick; t++) {
+            if (offerDepth[t - baseTick] != 0) {
+                _tick = t;
+                _quantity = offerDepth[t - baseTick];
+                break;
+            }
+        }
+        auto it = offerOverflow.upper_bound(_worst);
+        if (it != offerOverflow.end() &&
+            (_quantity == 0 || it->first < _tick)) {
+            _tick = it->first;
+            _quantity = it->second;
         }
     }
 
-    return BidOffer(highest_bid, lowest_offer);
+    if (_quantity != 0) {
+        aggregatedBook.UpdateOrder(Order(TickPrice(_tick), _quantity, _side));
+    }
 }
 
 template <typename T> MarketDataService<T>::MarketDataService() {
-    orderBooks = map<string, OrderBook<T>>();
     listeners = vector<ServiceListener<OrderBook<T>>*>();
     connector = new MarketDataConnector<T>(this);
     bookDepth = 10;
@@ -234,14 +660,18 @@ template <typename T> MarketDataService<T>::~MarketDataService() {
     delete connector;
 }
 
-template <typename T> OrderBook<T>& MarketDataService<T>::GetData(string _key) {
-    return orderBooks[_key];
+template <typename T> OrderBook<T>& MarketDataService<T>::GetData(Cusip _key) {
+    return orderBooks[GetProductRegistry<T>().At(_key)];
 }
 
 template <typename T>
 void MarketDataService<T>::OnMessage(OrderBook<T>& _data) {
-    string product_id = _data.GetProduct().GetProductId();
-    orderBooks[product_id] = _data;
+    OrderBook<T>& _book = orderBooks[_data.GetProductHandle().GetIndex()];
+
+    // the connector hands over the live book, only copy books built elsewhere
+    if (&_book != &_data) {
+        _book = _data;
+    }
 
     for (auto& listener : listeners) {
         listener->ProcessAdd(_data);
@@ -271,44 +701,82 @@ template <typename T> int MarketDataService<T>::GetOrderBookDepth() const {
 
 // Get the best bid/offer order
 template <typename T>
-const BidOffer MarketDataService<T>::GetBestBidOffer(const string& _id) {
-    return orderBooks[_id].GetBidOffer();
+const BidOffer& MarketDataService<T>::GetBestBidOffer(const Cusip& _id) {
+    return orderBooks[GetProductRegistry<T>().At(_id)].GetBidOffer();
 }
 
 // Aggregate the order book
+// The first call for a product starts its aggregation, later level updates
+// keep the aggregated book current without rebuilding it.
 template <typename T>
-const OrderBook<T>& MarketDataService<T>::AggregateDepth(const string& _id) {
-    T& _product = orderBooks[_id].GetProduct();
-
-    vector<Order>& origBidStack = orderBooks[_id].GetBidStack();
-    vector<Order>& origOfferStack = orderBooks[_id].GetOfferStack();
-
-    unordered_map<double, long> bidMap;
-    unordered_map<double, long> offerMap;
-
-    for (auto& bid : origBidStack) {
-        double p = bid.GetPrice();
-        double q = bid.GetQuantity();
-        bidMap[p] += q;
+const OrderBook<T>& MarketDataService<T>::AggregateDepth(const Cusip& _id) {
+    ProductIndex _index = GetProductRegistry<T>().At(_id);
+    DepthAggregator<T>* _depth = depths.Find(_index);
+    if (_depth == nullptr) {
+        _depth =
+            &depths.Insert(_index, DepthAggregator<T>(orderBooks[_index]));
     }
-    vector<Order> newBidStack;
-    for (auto& [price, quantity] : bidMap) {
-        Order tmpBidOrder(price, quantity, BID);
-        newBidStack.push_back(tmpBidOrder);
+    return _depth->GetOrderBook();
+}
+
+template <typename T>
+OrderBook<T>& MarketDataService<T>::UpdateOrderBook(ProductIndex _index,
+                                                    const Order& _order) {
+    OrderBook<T>* _book = orderBooks.Find(_index);
+    if (_book == nullptr) {
+        _book = &orderBooks.Insert(
+            _index, OrderBook<T>(_index, vector<Order>(), vector<Order>()));
     }
 
-    for (auto& offer : origOfferStack) {
-        double p = offer.GetPrice();
-        double q = offer.GetQuantity();
-        offerMap[p] += q;
+    DepthAggregator<T>* _depth = depths.Find(_index);
+    if (_depth == nullptr) {
+        _book->UpdateOrder(_order);
+    } else {
+        DepthAggregator<T>& _aggregator = *_depth;
+        _book->UpdateOrder(
+            _order, [&_aggregator](TickPrice _p, long _q, PricingSide _s) {
+                _aggregator.Add(_p, _q, _s);
+            });
     }
-    vector<Order> newOfferStack;
-    for (auto& [price, quantity] : bidMap) {
-        Order tmpOfferOrder(price, quantity, OFFER);
-        newOfferStack.push_back(tmpOfferOrder);
+    return *_book;
+}
+
+template <typename T>
+OrderBook<T>& MarketDataService<T>::UpdateOrderBook(const Cusip& _productId,
+                                                    const Order& _order) {
+    return UpdateOrderBook(GetProductRegistry<T>().At(_productId), _order);
+}
+
+template <typename T>
+void MarketDataService<T>::RemoveStaleOrders(ProductIndex _index) {
+    OrderBook<T>& _book = orderBooks[_index];
+
+    DepthAggregator<T>* _depth = depths.Find(_index);
+    if (_depth == nullptr) {
+        _book.RemoveStaleOrders();
+    } else {
+        DepthAggregator<T>& _aggregator = *_depth;
+        _book.RemoveStaleOrders(
+            [&_aggregator](TickPrice _p, long _q, PricingSide _s) {
+                _aggregator.Add(_p, _q, _s);
+            });
     }
+}
+
+template <typename T>
+void MarketDataService<T>::RemoveStaleOrders(const Cusip& _productId) {
+    RemoveStaleOrders(GetProductRegistry<T>().At(_productId));
+}
 
-    return OrderBook<T>(_product, newBidStack, newOfferStack);
+template <typename T> long MarketDataService<T>::GetDroppedLevels() const {
+    long _dropped = 0;
+    size_t _products = GetProductRegistry<T>().GetSize();
+    for (ProductIndex i = 0; i < _products; i++) {
+        if (const OrderBook<T>* _book = orderBooks.Find(i)) {
+            _dropped += _book->GetDroppedLevels();
+        }
+    }
+    return _dropped;
 }
 
 template <typename T>
@@ -320,53 +788,95 @@ template <typename T>
 void MarketDataConnector<T>::Publish(OrderBook<T>& _data) {}
 
 template <typename T> void MarketDataConnector<T>::Subscribe(ifstream& _data) {
-    // ready to process data
-    int bookDepth = service->GetOrderBookDepth();
-    int _thread = bookDepth * 2;
-    long orderCount = 0; // keep track of total orders added
-
-    vector<Order> bidStack;
-    vector<Order> offerStack;
-
     string line;
+    string_view vecs[4];
     while (getline(_data, line)) {
+        ProcessFields(vecs, SplitFields(line, vecs, 4));
+    }
+}
 
-        stringstream lineStream(line);
-        string tmp;
-        vector<string> vecs;
-        while (getline(lineStream, tmp, ',')) {
-            vecs.push_back(tmp);
-        }
+template <typename T>
+void MarketDataConnector<T>::Subscribe(LineSource& _data) {
+    string_view vecs[4];
+    int _count;
+    while ((_count = _data.GetFields(vecs, 4)) >= 0) {
+        ProcessFields(vecs, _count);
+    }
+}
 
-        // process data
-        auto _productId = vecs[0];
-        double _price = string2price(vecs[1]);
-        long _quantity = stol(vecs[2]);
+template <typename T>
+void MarketDataConnector<T>::Subscribe(const MappedFile& _data,
+                                       ThreadPool& _pool) {
+    ParseInParallel<LevelUpdate, 4>(
+        _data.GetData(), _data.GetData() + _data.GetSize(), _pool,
+        [this](const string_view* vecs, int _count, LevelUpdate& _update) {
+            return ParseFields(vecs, _count, _update);
+        },
+        [this](LevelUpdate& _update) { ApplyUpdate(_update); });
+}
 
-        // convert string to SIDE
-        // assume no ill-shaped inputs
-        PricingSide side = vecs[3] == "BID" ? BID : OFFER;
+template <typename T>
+bool MarketDataConnector<T>::ParseFields(const string_view* vecs, int _count,
+                                         LevelUpdate& _update) const {
+    if (_count < 4) {
+        cerr << "Error: Invalid market data line " << vecs[0] << endl;
+        return false;
+    }
 
-        // generate order
-        Order order(_price, _quantity, side);
-        if (side == BID) {
-            bidStack.push_back(order);
-        } else {
-            offerStack.push_back(order);
-        }
-        orderCount++;
-
-        // This will trigger the OnMessage updates
-        // since both BID and ASK offers have been processed
-        if (orderCount % _thread == 0) {
-            T _product = GetBond(_productId);
-            OrderBook<T> tmpOrderBook(_product, bidStack, offerStack);
-            service->OnMessage(tmpOrderBook);
-
-            // reset, empty the stacks.
-            bidStack = vector<Order>();
-            offerStack = vector<Order>();
-        }
+    // process data
+    ProductIndex _index = GetProductRegistry<T>().Find(vecs[0]);
+    if (_index == INVALID_PRODUCT_INDEX) {
+        cerr << "Error: Unknown product " << vecs[0] << endl;
+        return false;
+    }
+    TickPrice _price;
+    if (ParsePrice(vecs[1], _price) != PRICE_OK) {
+        cerr << "Error: Invalid price " << vecs[1] << endl;
+        return false;
+    }
+    long _quantity;
+    if (!ParseLong(vecs[2], _quantity)) {
+        cerr << "Error: Invalid quantity " << vecs[2] << endl;
+        return false;
+    }
+
+    // convert string to SIDE
+    // assume no ill-shaped inputs
+    PricingSide side = vecs[3] == "BID" ? BID : OFFER;
+
+    _update.product = _index;
+    _update.order = Order(_price, _quantity, side);
+    return true;
+}
+
+template <typename T>
+void MarketDataConnector<T>::SetCountPerProduct(bool _perProduct) {
+    orderCount.SetPerProduct(_perProduct);
+}
+
+template <typename T>
+void MarketDataConnector<T>::ApplyUpdate(const LevelUpdate& _update) {
+    // apply the level update on the live book
+    OrderBook<T>& _book =
+        service->UpdateOrderBook(_update.product, _update.order);
+    long _orderCount = ++orderCount[_update.product];
+
+    // This will trigger the OnMessage updates
+    // since both BID and ASK offers have been processed.
+    // Levels missing from this round of updates have left the book.
+    int _thread = service->GetOrderBookDepth() * 2;
+    if (_orderCount % _thread == 0) {
+        service->RemoveStaleOrders(_update.product);
+        service->OnMessage(_book);
+    }
+}
+
+template <typename T>
+void MarketDataConnector<T>::ProcessFields(const string_view* vecs,
+                                           int _count) {
+    LevelUpdate _update;
+    if (ParseFields(vecs, _count, _update)) {
+        ApplyUpdate(_update);
     }
 }
 
@@ -0,0 +1,85 @@
+/**
+ * parallelingest.hpp
+ * Defines chunked parsing of an input buffer on a thread pool.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef PARALLEL_INGEST_HPP
+#define PARALLEL_INGEST_HPP
+
+#include "mappedfile.hpp"
+#include "threadpool.hpp"
+#include <cstring>
+#include <deque>
+#include <future>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Bytes of input parsed by one task, rounded up to the next line end
+constexpr size_t INGEST_CHUNK_SIZE = 1 << 22;
+
+// Chunks parsed ahead of the consumer for every worker of the pool
+constexpr int INGEST_CHUNKS_PER_THREAD = 2;
+
+// Get the end of the chunk starting at _begin, just after a newline or at _end
+const char* NextChunkEnd(const char* _begin, const char* _end) {
+    if (static_cast<size_t>(_end - _begin) <= INGEST_CHUNK_SIZE) {
+        return _end;
+    }
+    const char* _newline = static_cast<const char*>(
+        memchr(_begin + INGEST_CHUNK_SIZE, '\n',
+               _end - _begin - INGEST_CHUNK_SIZE));
+    return _newline != nullptr ? _newline + 1 : _end;
+}
+
+// Parse the lines of a buffer on the pool and hand the records to _consume
+// on the calling thread, in the order of the lines in the buffer.
+// The buffer is split at line boundaries into chunks. Each chunk is tokenized
+// by its own LineSource and every line split into at most N fields, which
+// _parse(const string_view*, int, R&) turns into a record R, returning false
+// for a line to skip. _parse runs concurrently and must not touch shared
+// state; _consume(R&) runs on the caller only, so it can drive the services.
+// A bounded number of chunks are parsed ahead, so memory use does not grow
+// with the file.
+template <typename R, int N, typename P, typename C>
+void ParseInParallel(const char* _begin, const char* _end, ThreadPool& _pool,
+                     P _parse, C _consume) {
+    auto _parseChunk = [_parse](const char* _chunkBegin,
+                                const char* _chunkEnd) {
+        vector<R> _records;
+        LineSource _lines(_chunkBegin, _chunkEnd);
+        string_view _fields[N];
+        R _record;
+        int _count;
+        while ((_count = _lines.GetFields(_fields, N)) >= 0) {
+            if (_parse(_fields, _count, _record)) {
+                _records.push_back(move(_record));
+            }
+        }
+        return _records;
+    };
+
+    size_t _ahead = _pool.GetThreadCount() * INGEST_CHUNKS_PER_THREAD;
+    deque<future<vector<R>>> _pending;
+    const char* _next = _begin;
+    while (_next != _end || !_pending.empty()) {
+        // keep the pool busy while the oldest chunk is consumed
+        while (_next != _end && _pending.size() < _ahead) {
+            const char* _chunkEnd = NextChunkEnd(_next, _end);
+            _pending.push_back(_pool.Submit([_parseChunk, _next, _chunkEnd]() {
+                return _parseChunk(_next, _chunkEnd);
+            }));
+            _next = _chunkEnd;
+        }
+
+        vector<R> _records = _pending.front().get();
+        _pending.pop_front();
+        for (R& _record : _records) {
+            _consume(_record);
+        }
+    }
+}
+
+#endif
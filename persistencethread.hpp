@@ -0,0 +1,241 @@
+/**
+ * persistencethread.hpp
+ * Defines a background thread persisting queued records with group commit.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef PERSISTENCE_THREAD_HPP
+#define PERSISTENCE_THREAD_HPP
+
+#include "asyncpipeline.hpp"
+#include "bufferedwriter.hpp"
+#include "soa.hpp"
+#include "spscring.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Records queued for a file before its producer has to wait
+constexpr size_t PERSISTENCE_QUEUE_CAPACITY = 4096;
+
+/**
+ * Queue of records waiting to be persisted, whatever their type.
+ */
+class PersistenceQueueBase {
+
+  public:
+    virtual ~PersistenceQueueBase() {}
+
+    // Publish the records queued, up to a batch, as one commit, returning
+    // the number published
+    virtual size_t Commit() = 0;
+
+    // Check whether every record queued has been published
+    virtual bool IsIdle() const = 0;
+
+    // Write what the connector has buffered past its time threshold
+    virtual void FlushIfDue() = 0;
+};
+
+/**
+ * Queue of raw records for one connector, published in the order they were
+ * queued. Records are copied in as they are, and only formatted by the
+ * connector once the persistence thread takes them off.
+ * The queue has a single producer: only one thread may push at a time.
+ * Type V is the data type.
+ */
+template <typename V> class PersistenceQueue : public PersistenceQueueBase {
+
+  public:
+    // ctor for a queue publishing to a connector, and flushing it on time
+    // with _flush
+    PersistenceQueue(Connector<V>* _connector, function<void()> _flush);
+
+    // Queue a record, waiting for room while the queue is full
+    void Push(const V& _data);
+
+    // Publish the records queued, up to a batch, as one commit, returning
+    // the number published
+    size_t Commit();
+
+    // Check whether every record queued has been published
+    bool IsIdle() const;
+
+    // Write what the connector has buffered past its time threshold
+    void FlushIfDue();
+
+  private:
+    Connector<V>* connector;
+    function<void()> flush;
+    SpscRing<V> ring;
+    vector<V> batch;
+    // counted before a record is pushed, so it never trails published
+    atomic<uint64_t> queued;
+    atomic<uint64_t> published;
+};
+
+/**
+ * Thread persisting records off the trading path. Services queue raw records
+ * on a queue of their own; the thread takes whatever has queued up on each
+ * and hands it to the connector as one batch, so a batch costs one write,
+ * and one sync if the connector syncs, however many records it holds.
+ * Records of one queue are published in order. When a pass finds nothing
+ * to publish, the thread flushes every queue on time, so buffered records
+ * do not wait for the next one to reach the file.
+ */
+class PersistenceThread {
+
+  public:
+    // ctor starting the thread
+    PersistenceThread();
+
+    // Publish everything queued, then stop the thread
+    ~PersistenceThread();
+
+    PersistenceThread(const PersistenceThread&) = delete;
+    PersistenceThread& operator=(const PersistenceThread&) = delete;
+
+    // Get a new queue publishing to a connector, owned by the thread.
+    // _flush writes what the connector has buffered past its time threshold.
+    template <typename V>
+    PersistenceQueue<V>* AddQueue(Connector<V>* _connector,
+                                  function<void()> _flush = nullptr);
+
+    // Wait until every record queued has been published
+    void Drain();
+
+  private:
+    // Publish from every queue until stopped
+    void Run();
+
+    // Check whether every queue is idle
+    bool IsIdle();
+
+    mutex queuesLock;
+    vector<unique_ptr<PersistenceQueueBase>> queues;
+    atomic<bool> stopping;
+    thread worker;
+};
+
+template <typename V>
+PersistenceQueue<V>::PersistenceQueue(Connector<V>* _connector,
+                                      function<void()> _flush)
+    : connector(_connector), flush(move(_flush)),
+      ring(PERSISTENCE_QUEUE_CAPACITY), queued(0), published(0) {
+    batch.reserve(CONNECTOR_BATCH_SIZE);
+}
+
+template <typename V> void PersistenceQueue<V>::Push(const V& _data) {
+    queued.fetch_add(1);
+    while (!ring.TryPush(_data)) {
+        this_thread::yield();
+    }
+}
+
+template <typename V> size_t PersistenceQueue<V>::Commit() {
+    V _data;
+    while (batch.size() < CONNECTOR_BATCH_SIZE && ring.TryPop(_data)) {
+        batch.push_back(move(_data));
+    }
+    size_t _count = batch.size();
+    if (_count > 0) {
+        connector->PublishBatch(batch.data(), _count);
+        batch.clear();
+        published.fetch_add(_count);
+    }
+    return _count;
+}
+
+template <typename V> bool PersistenceQueue<V>::IsIdle() const {
+    return published.load() == queued.load();
+}
+
+template <typename V> void PersistenceQueue<V>::FlushIfDue() {
+    if (flush) {
+        flush();
+    }
+}
+
+PersistenceThread::PersistenceThread()
+    : stopping(false), worker(&PersistenceThread::Run, this) {}
+
+PersistenceThread::~PersistenceThread() {
+    stopping.store(true);
+    worker.join();
+}
+
+template <typename V>
+PersistenceQueue<V>* PersistenceThread::AddQueue(Connector<V>* _connector,
+                                                function<void()> _flush) {
+    PersistenceQueue<V>* _queue =
+        new PersistenceQueue<V>(_connector, move(_flush));
+    lock_guard<mutex> _lock(queuesLock);
+    queues.emplace_back(_queue);
+    return _queue;
+}
+
+void PersistenceThread::Drain() {
+    while (!IsIdle()) {
+        this_thread::yield();
+    }
+}
+
+bool PersistenceThread::IsIdle() {
+    lock_guard<mutex> _lock(queuesLock);
+    for (auto& q : queues) {
+        if (!q->IsIdle()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PersistenceThread::Run() {
+    int _polls = 0;
+    vector<PersistenceQueueBase*> _queues;
+    auto _lastFlush = chrono::steady_clock::now();
+    while (true) {
+        // stopping is checked before polling, so nothing queued before the
+        // stop is left behind
+        bool _stopping = stopping.load();
+
+        // queues are only ever added, so a snapshot of them can be committed
+        // without holding up AddQueue and Drain on the writes
+        {
+            lock_guard<mutex> _lock(queuesLock);
+            _queues.clear();
+            for (auto& q : queues) {
+                _queues.push_back(q.get());
+            }
+        }
+        size_t _published = 0;
+        for (auto& q : _queues) {
+            _published += q->Commit();
+        }
+
+        if (_published > 0) {
+            _polls = 0;
+        } else if (_stopping) {
+            return;
+        } else {
+            auto _now = chrono::steady_clock::now();
+            if (_now - _lastFlush >=
+                chrono::milliseconds(FLUSH_TIMER_MILLISECONDS)) {
+                for (auto& q : _queues) {
+                    q->FlushIfDue();
+                }
+                _lastFlush = _now;
+            }
+            BackOff(++_polls);
+        }
+    }
+}
+
+#endif
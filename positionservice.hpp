@@ -23,11 +23,14 @@ template <typename T> class Position {
   public:
     // ctor for a position
     Position() = default;
-    Position(const T& _product);
+    Position(ProductHandle<T> _product);
 
     // Get the product
     const T& GetProduct() const;
 
+    // Get the handle of the product
+    ProductHandle<T> GetProductHandle() const;
+
     // Get the position quantity
     long GetPosition(string& book);
 
@@ -44,14 +47,19 @@ template <typename T> class Position {
     vector<string> PrintFunction() const;
 
   private:
-    T product;
+    ProductHandle<T> product;
     map<string, long> positions;
 };
 
 template <typename T>
-Position<T>::Position(const T& _product) : product(_product) {}
+Position<T>::Position(ProductHandle<T> _product) : product(_product) {}
 
 template <typename T> const T& Position<T>::GetProduct() const {
+    return product.Get();
+}
+
+template <typename T>
+ProductHandle<T> Position<T>::GetProductHandle() const {
     return product;
 }
 
@@ -77,7 +85,7 @@ template <typename T> long Position<T>::GetAggregatePosition() {
 }
 
 template <typename T> vector<string> Position<T>::PrintFunction() const {
-    string _product = product.GetProductId();
+    string _product = product.Get().GetProductId();
     vector<string> _positions;
 
     // storing the market and corresponding positions
@@ -101,18 +109,18 @@ template <typename T> class PositionServiceListener;
 
 /**
  * Position Service to manage positions across multiple books and secruties.
- * Keyed on product identifier.
+ * Keyed on product CUSIP, held by product index.
  * Type T is the product type.
  */
 template <typename T>
-class PositionService : public Service<string, Position<T>> {
+class PositionService : public Service<Cusip, Position<T>> {
 
   public:
     // Ctor
     PositionService();
 
     // Get data on our service on the given id
-    Position<T>& GetData(string _key);
+    Position<T>& GetData(Cusip _key);
 
     // Call back function that a Connector should invoke for any new or updated
     // data
@@ -128,27 +136,31 @@ class PositionService : public Service<string, Position<T>> {
     PositionServiceListener<T>* GetListener();
 
     // Add a trade to the service
+    // _emit(Position<T>&) is handed the position in place of the listeners.
     virtual void AddTrade(const Trade<T>& _trade);
+    template <typename F> void AddTrade(const Trade<T>& _trade, F _emit);
+
+    // Add a batch of trades, flowing the positions to the listeners as one
+    // batch
+    void AddTrades(const Trade<T>* _trades, size_t _count);
 
   private:
-    map<string, Position<T>> positions;
+    ProductTable<Position<T>> positions;
     vector<ServiceListener<Position<T>>*> listeners;
     PositionServiceListener<T>* listener;
 };
 
 template <typename T> PositionService<T>::PositionService() {
-    positions = map<string, Position<T>>();
     listeners = vector<ServiceListener<Position<T>>*>();
     listener = new PositionServiceListener<T>(this);
 }
 
-template <typename T> Position<T>& PositionService<T>::GetData(string _key) {
-    return positions[_key];
+template <typename T> Position<T>& PositionService<T>::GetData(Cusip _key) {
+    return positions[GetProductRegistry<T>().At(_key)];
 }
 
 template <typename T> void PositionService<T>::OnMessage(Position<T>& _data) {
-    string _id = _data.GetProduct().GetProductId();
-    positions[_id] = _data;
+    positions.Insert(_data.GetProductHandle().GetIndex(), _data);
 }
 
 template <typename T>
@@ -170,8 +182,14 @@ PositionService<T>::GetListeners() const {
 // Add a trade to the system
 template <typename T>
 void PositionService<T>::AddTrade(const Trade<T>& _trade) {
-    T _product = _trade.GetProduct();
-    string _productId = _product.GetProductId();
+    AddTrade(_trade, ListenerEmitter<Position<T>>(listeners));
+}
+
+template <typename T>
+template <typename F>
+void PositionService<T>::AddTrade(const Trade<T>& _trade, F _emit) {
+    ProductHandle<T> _product = _trade.GetProductHandle();
+    ProductIndex _index = _product.GetIndex();
     string _book = _trade.GetBook();
     long _quantity = _trade.GetQuantity();
     Side _side = _trade.GetSide();
@@ -183,18 +201,31 @@ void PositionService<T>::AddTrade(const Trade<T>& _trade) {
         _positionTo.AddPosition(_book, -_quantity);
     }
 
-    Position<T> _positionFrom = positions[_productId];
+    Position<T> _positionFrom = positions[_index];
     map<string, long> _positionMap = _positionFrom.GetPositions();
     for (auto& p : _positionMap) {
         _book = p.first;
         _quantity = p.second;
         _positionTo.AddPosition(_book, _quantity);
     }
-    positions[_productId] = _positionTo;
+    positions[_index] = _positionTo;
 
     // flow to the listeners
+    _emit(_positionTo);
+}
+
+template <typename T>
+void PositionService<T>::AddTrades(const Trade<T>* _trades, size_t _count) {
+    vector<Position<T>> _positions;
+    _positions.reserve(_count);
+    for (size_t i = 0; i < _count; i++) {
+        AddTrade(_trades[i], [&_positions](Position<T>& _position) {
+            _positions.push_back(_position);
+        });
+    }
+
     for (auto& l : listeners) {
-        l->ProcessAdd(_positionTo);
+        l->ProcessAddBatch(_positions.data(), _positions.size());
     }
 }
 
@@ -217,6 +248,10 @@ class PositionServiceListener : public ServiceListener<Trade<T>> {
 
     // Listener callback to process an add event to the Service
     void ProcessAdd(Trade<T>& _data);
+    template <typename F> void ProcessAdd(Trade<T>& _data, F _emit);
+
+    // Listener callback to process add events for a batch of trades
+    void ProcessAddBatch(Trade<T>* _data, size_t _count);
 
     // Listener callback to process a remove event to the Service
     void ProcessRemove(Trade<T>& _data);
@@ -236,6 +271,18 @@ void PositionServiceListener<T>::ProcessAdd(Trade<T>& _data) {
     service->AddTrade(_data);
 }
 
+template <typename T>
+template <typename F>
+void PositionServiceListener<T>::ProcessAdd(Trade<T>& _data, F _emit) {
+    service->AddTrade(_data, _emit);
+}
+
+template <typename T>
+void PositionServiceListener<T>::ProcessAddBatch(Trade<T>* _data,
+                                                 size_t _count) {
+    service->AddTrades(_data, _count);
+}
+
 template <typename T>
 void PositionServiceListener<T>::ProcessRemove(Trade<T>& _data) {}
 
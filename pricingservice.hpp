@@ -10,11 +10,13 @@
 #ifndef PRICING_SERVICE_HPP
 #define PRICING_SERVICE_HPP
 
+#include "parallelingest.hpp"
 #include "utility.hpp"
 #include <string>
 
 /**
- * A price object consisting of mid and bid/offer spread.
+ * A price object consisting of a bid and an offer price, kept as exact
+ * ticks, since the mid of an odd spread falls on a half tick.
  * Type T is the product type.
  */
 template <typename T> class Price {
@@ -22,16 +24,25 @@ template <typename T> class Price {
   public:
     // ctor
     Price() = default;
-    Price(const T& _product, double _mid, double _bidOfferSpread);
+    Price(ProductHandle<T> _product, TickPrice _bid, TickPrice _offer);
 
     // Get the product
     const T& GetProduct() const;
 
-    // Get the mid price
-    double GetMid() const;
+    // Get the handle of the product
+    ProductHandle<T> GetProductHandle() const;
+
+    // Get the mid price, rounded down to a whole tick
+    TickPrice GetMid() const;
 
     // Get the bid/offer spread around the mid
-    double GetBidOfferSpread() const;
+    TickPrice GetBidOfferSpread() const;
+
+    // Get the bid price
+    TickPrice GetBid() const;
+
+    // Get the offer price
+    TickPrice GetOffer() const;
 
     // Change attributes to strings
     vector<string> ToStrings() const;
@@ -39,30 +50,43 @@ template <typename T> class Price {
     vector<string> PrintFunction() const;
 
   private:
-    T product;
-    double mid;
-    double bidOfferSpread;
+    ProductHandle<T> product;
+    TickPrice bid;
+    TickPrice offer;
 };
 
 template <typename T>
-Price<T>::Price(const T& _product, double _mid, double _bidOfferSpread)
+Price<T>::Price(ProductHandle<T> _product, TickPrice _bid, TickPrice _offer)
     : product(_product) {
-    mid = _mid;
-    bidOfferSpread = _bidOfferSpread;
+    bid = _bid;
+    offer = _offer;
 }
 
-template <typename T> const T& Price<T>::GetProduct() const { return product; }
+template <typename T> const T& Price<T>::GetProduct() const {
+    return product.Get();
+}
+
+template <typename T>
+ProductHandle<T> Price<T>::GetProductHandle() const {
+    return product;
+}
 
-template <typename T> double Price<T>::GetMid() const { return mid; }
+template <typename T> TickPrice Price<T>::GetMid() const {
+    return TickPrice((bid.GetTicks() + offer.GetTicks()) / 2);
+}
 
-template <typename T> double Price<T>::GetBidOfferSpread() const {
-    return bidOfferSpread;
+template <typename T> TickPrice Price<T>::GetBidOfferSpread() const {
+    return offer - bid;
 }
 
+template <typename T> TickPrice Price<T>::GetBid() const { return bid; }
+
+template <typename T> TickPrice Price<T>::GetOffer() const { return offer; }
+
 template <typename T> vector<string> Price<T>::PrintFunction() const {
-    string _product = product.GetProductId();
-    string _mid = price2string(mid);
-    string _bidOfferSpread = price2string(bidOfferSpread);
+    string _product = product.Get().GetProductId();
+    string _mid = price2string(GetMid());
+    string _bidOfferSpread = price2string(GetBidOfferSpread());
 
     vector<string> _strings;
     _strings.push_back(_product);
@@ -76,21 +100,25 @@ template <typename T> class PricingConnector;
 
 /**
  * Pricing Service managing mid prices and bid/offers.
- * Keyed on product identifier.
+ * Keyed on product CUSIP, held by product index.
  * Type T is the product type.
  */
-template <typename T> class PricingService : public Service<string, Price<T>> {
+template <typename T> class PricingService : public Service<Cusip, Price<T>> {
   public:
     PricingService();
     ~PricingService();
 
     // Get data on our service given product id
-    Price<T>& GetData(string _key);
+    Price<T>& GetData(Cusip _key);
 
     // Call back function that a Connector should invoke for any new or updated
     // data
     void OnMessage(Price<T>& _data);
 
+    // Call back function for a Connector to push a batch of prices, which
+    // flows to the listeners as one batch
+    void OnMessageBatch(Price<T>* _data, size_t _count);
+
     // Add listener to the service
     void AddListener(ServiceListener<Price<T>>* listener);
 
@@ -101,7 +129,7 @@ template <typename T> class PricingService : public Service<string, Price<T>> {
     PricingConnector<T>* GetConnector();
 
   private:
-    std::map<string, Price<T>> prices;
+    ProductTable<Price<T>> prices;
     vector<ServiceListener<Price<T>>*> listeners;
     PricingConnector<T>* connector;
 };
@@ -117,30 +145,47 @@ template <typename T> class PricingConnector : public Connector<Price<T>> {
     // Subscribe data from the Connector
     void Subscribe(ifstream& _data);
 
+    // Subscribe data from lines of a memory mapped source
+    void Subscribe(LineSource& _data);
+
+    // Subscribe data from a memory mapped file, parsing chunks of it on the
+    // pool and flowing the prices to the service in file order
+    void Subscribe(const MappedFile& _data, ThreadPool& _pool);
+
   private:
+    // Parse the fields of one line into a price, false if it is invalid.
+    // Safe to call from several threads.
+    bool ParseFields(const string_view* vecs, int _count,
+                     Price<T>& _price) const;
+
+    // Parse the fields of one line and add the price to the batch
+    void ProcessFields(const string_view* vecs, int _count);
+
+    // Add a price to the batch, pushing the batch to the service once full
+    void AddToBatch(Price<T>& _price);
+
+    // Push the batched prices to the service
+    void FlushBatch();
+
     PricingService<T>* service;
+    vector<Price<T>> batch;
 };
 
 template <typename T>
 PricingService<T>::PricingService() : prices(), listeners(), connector() {
-    prices = map<string, Price<T>>();
     listeners = vector<ServiceListener<Price<T>>*>();
     connector = new PricingConnector<T>(this);
 }
 
 template <typename T> PricingService<T>::~PricingService() {}
 
-template <typename T> Price<T>& PricingService<T>::GetData(string _key) {
-    return prices[_key];
+template <typename T> Price<T>& PricingService<T>::GetData(Cusip _key) {
+    return prices[GetProductRegistry<T>().At(_key)];
 }
 
 template <typename T> void PricingService<T>::OnMessage(Price<T>& _data) {
-    string id = _data.GetProduct().GetProductId();
-    // update the price map
-    if (prices.find(id) != prices.end()) {
-        prices.erase(id);
-    }
-    prices.insert(pair<string, Price<Bond>>(id, _data));
+    // update the price table
+    prices.Insert(_data.GetProductHandle().GetIndex(), _data);
 
     // flow the data to listeners
     for (auto& listener : listeners) {
@@ -148,6 +193,17 @@ template <typename T> void PricingService<T>::OnMessage(Price<T>& _data) {
     }
 }
 
+template <typename T>
+void PricingService<T>::OnMessageBatch(Price<T>* _data, size_t _count) {
+    for (size_t i = 0; i < _count; i++) {
+        prices.Insert(_data[i].GetProductHandle().GetIndex(), _data[i]);
+    }
+
+    for (auto& listener : listeners) {
+        listener->ProcessAddBatch(_data, _count);
+    }
+}
+
 template <typename T>
 void PricingService<T>::AddListener(ServiceListener<Price<T>>* _listener) {
     listeners.push_back(_listener);
@@ -166,34 +222,89 @@ template <typename T> PricingConnector<T>* PricingService<T>::GetConnector() {
 template <typename T>
 PricingConnector<T>::PricingConnector(PricingService<T>* _service) {
     service = _service;
+    batch.reserve(CONNECTOR_BATCH_SIZE);
 }
 
 template <typename T> void PricingConnector<T>::Publish(Price<T>& _data) {}
 
 // Read from "price.txt" and process the data
 template <typename T> void PricingConnector<T>::Subscribe(ifstream& _data) {
-
     string line;
+    string_view vecs[3];
     while (getline(_data, line)) {
+        ProcessFields(vecs, SplitFields(line, vecs, 3));
+    }
+    FlushBatch();
+}
+
+template <typename T> void PricingConnector<T>::Subscribe(LineSource& _data) {
+    string_view vecs[3];
+    int _count;
+    while ((_count = _data.GetFields(vecs, 3)) >= 0) {
+        ProcessFields(vecs, _count);
+    }
+    FlushBatch();
+}
 
-        stringstream lineStream(line);
-        string tmp;
-        vector<string> vecs;
-        while (getline(lineStream, tmp, ',')) {
-            vecs.push_back(tmp);
-        }
+template <typename T>
+void PricingConnector<T>::Subscribe(const MappedFile& _data,
+                                    ThreadPool& _pool) {
+    ParseInParallel<Price<T>, 3>(
+        _data.GetData(), _data.GetData() + _data.GetSize(), _pool,
+        [this](const string_view* vecs, int _count, Price<T>& _price) {
+            return ParseFields(vecs, _count, _price);
+        },
+        [this](Price<T>& _price) { AddToBatch(_price); });
+    FlushBatch();
+}
 
-        // read and split the corresponding data features
-        string _productId = vecs[0];
-        T _product = GetBond(_productId);
-        double bid_price = string2price(vecs[1]);
-        double offer_price = string2price(vecs[2]);
-        double mid_price = (bid_price + offer_price) / 2.0;
-        double spread = offer_price - bid_price;
+template <typename T>
+bool PricingConnector<T>::ParseFields(const string_view* vecs, int _count,
+                                      Price<T>& _price) const {
+    if (_count < 3) {
+        cerr << "Error: Invalid price line " << vecs[0] << endl;
+        return false;
+    }
 
-        Price<T> _price(_product, mid_price, spread);
+    // read and split the corresponding data features
+    const ProductRegistry<T>& _registry = GetProductRegistry<T>();
+    ProductIndex _index = _registry.Find(vecs[0]);
+    if (_index == INVALID_PRODUCT_INDEX) {
+        cerr << "Error: Unknown product " << vecs[0] << endl;
+        return false;
+    }
+    TickPrice bid_price;
+    TickPrice offer_price;
+    if (ParsePrice(vecs[1], bid_price) != PRICE_OK ||
+        ParsePrice(vecs[2], offer_price) != PRICE_OK) {
+        cerr << "Error: Invalid prices " << vecs[1] << "," << vecs[2] << endl;
+        return false;
+    }
+
+    _price = Price<T>(_index, bid_price, offer_price);
+    return true;
+}
+
+template <typename T>
+void PricingConnector<T>::ProcessFields(const string_view* vecs,
+                                        int _count) {
+    Price<T> _price;
+    if (ParseFields(vecs, _count, _price)) {
+        AddToBatch(_price);
+    }
+}
+
+template <typename T> void PricingConnector<T>::AddToBatch(Price<T>& _price) {
+    batch.push_back(_price);
+    if (batch.size() == CONNECTOR_BATCH_SIZE) {
+        FlushBatch();
+    }
+}
 
-        service->OnMessage(_price);
+template <typename T> void PricingConnector<T>::FlushBatch() {
+    if (!batch.empty()) {
+        service->OnMessageBatch(batch.data(), batch.size());
+        batch.clear();
     }
 }
 
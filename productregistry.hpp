@@ -0,0 +1,288 @@
+/**
+ * productregistry.hpp
+ * Defines the registry interning products into dense integer indices, and
+ * flat per-product tables and counters indexed by them.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef PRODUCT_REGISTRY_HPP
+#define PRODUCT_REGISTRY_HPP
+
+#include "cusip.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Dense index of a registered product, in order of registration
+typedef uint32_t ProductIndex;
+
+// Index returned for a product which is not registered
+constexpr ProductIndex INVALID_PRODUCT_INDEX = UINT32_MAX;
+
+/**
+ * Registry interning every product once under a dense ProductIndex.
+ * Registered products are immutable and shared by everyone holding them.
+ * Products are keyed on their identifier as a Cusip. Lookups by Cusip hash
+ * and compare its two words; text identifiers are parsed into a Cusip
+ * first, so lookups never allocate. A product type can specialize
+ * Find(const Cusip&), as bonds do to use their perfect hash.
+ * Registration is not synchronized: products are registered up front, after
+ * which the registry can be read from several threads.
+ * Type T is the product type.
+ */
+template <typename T> class ProductRegistry {
+
+  public:
+    // Register a product, returns the index of an already registered one
+    // with the same identifier. Throws invalid_argument if the identifier
+    // is not a CUSIP.
+    ProductIndex Register(const T& _product);
+
+    // Get the index of a product, INVALID_PRODUCT_INDEX if unknown
+    ProductIndex Find(const Cusip& _productId) const;
+    ProductIndex Find(string_view _productId) const;
+
+    // Get the index of a product, throws out_of_range if unknown
+    ProductIndex At(const Cusip& _productId) const;
+    ProductIndex At(string_view _productId) const;
+
+    // Get a registered product
+    const T& Get(ProductIndex _index) const;
+
+    // Get shared ownership of a registered product
+    const shared_ptr<const T>& GetShared(ProductIndex _index) const;
+
+    // Get the number of registered products
+    size_t GetSize() const;
+
+  private:
+    vector<shared_ptr<const T>> products;
+    unordered_map<Cusip, ProductIndex> indices;
+};
+
+// Get the registry of a product type
+template <typename T> ProductRegistry<T>& GetProductRegistry() {
+    static ProductRegistry<T> _registry;
+    return _registry;
+}
+
+// Get the index of a product, registering the product if it is unknown
+template <typename T> ProductIndex GetProductIndex(const T& _product) {
+    ProductRegistry<T>& _registry = GetProductRegistry<T>();
+    ProductIndex _index = _registry.Find(_product.GetProductId());
+    return _index != INVALID_PRODUCT_INDEX ? _index
+                                           : _registry.Register(_product);
+}
+
+/**
+ * Flyweight handle of a registered product, standing in for the product in
+ * value objects. Copying it copies 4 bytes instead of the product.
+ * A default constructed handle refers to a default constructed product.
+ * Type T is the product type.
+ */
+template <typename T> class ProductHandle {
+
+  public:
+    // ctor for a handle of the registered product at the index
+    ProductHandle();
+    ProductHandle(ProductIndex _index);
+
+    // ctor for a handle of a product, registering it if it is unknown
+    ProductHandle(const T& _product);
+
+    // Get the product
+    const T& Get() const;
+
+    // Get the index of the product in its registry
+    ProductIndex GetIndex() const;
+
+  private:
+    ProductIndex index;
+};
+
+/**
+ * A flat table holding at most one value per product, indexed directly by
+ * ProductIndex instead of by the product identifier.
+ * The table grows to the largest index stored, which moves its values, so
+ * references into it only last until a value is stored for a new product.
+ * Type V is the value type.
+ */
+template <typename V> class ProductTable {
+
+  public:
+    // Get the value of a product, default constructing it on first use
+    V& operator[](ProductIndex _index);
+
+    // Get the value of a product, nullptr if it has none
+    V* Find(ProductIndex _index);
+    const V* Find(ProductIndex _index) const;
+
+    // Store the value of a product, replacing any previous one
+    V& Insert(ProductIndex _index, V _value);
+
+  private:
+    vector<optional<V>> values;
+};
+
+/**
+ * Counter of events, such as orders sent, kept over all products together
+ * or, once set per product, for each product on its own. Counting per
+ * product makes the count of a product independent of how the products are
+ * interleaved.
+ */
+class ProductCounter {
+
+  public:
+    // Get the count of a product, which is the count over all products
+    // unless counting per product
+    long& operator[](ProductIndex _index);
+
+    // Set whether to count each product on its own
+    void SetPerProduct(bool _perProduct);
+
+    // Whether each product is counted on its own
+    bool IsPerProduct() const;
+
+  private:
+    long total = 0;
+    ProductTable<long> counts;
+    bool perProduct = false;
+};
+
+template <typename T>
+ProductIndex ProductRegistry<T>::Register(const T& _product) {
+    Cusip _productId;
+    if (!Cusip::Parse(_product.GetProductId(), _productId)) {
+        throw invalid_argument("Product id is not a CUSIP " +
+                               _product.GetProductId());
+    }
+    ProductIndex _index = Find(_productId);
+    if (_index != INVALID_PRODUCT_INDEX) {
+        return _index;
+    }
+
+    _index = static_cast<ProductIndex>(products.size());
+    products.push_back(make_shared<const T>(_product));
+    indices.emplace(_productId, _index);
+    return _index;
+}
+
+template <typename T>
+ProductIndex ProductRegistry<T>::Find(const Cusip& _productId) const {
+    auto it = indices.find(_productId);
+    return it == indices.end() ? INVALID_PRODUCT_INDEX : it->second;
+}
+
+template <typename T>
+ProductIndex ProductRegistry<T>::Find(string_view _productId) const {
+    Cusip _id;
+    return Cusip::Parse(_productId, _id) ? Find(_id) : INVALID_PRODUCT_INDEX;
+}
+
+template <typename T>
+ProductIndex ProductRegistry<T>::At(const Cusip& _productId) const {
+    ProductIndex _index = Find(_productId);
+    if (_index == INVALID_PRODUCT_INDEX) {
+        throw out_of_range("Unknown product " + _productId.ToString());
+    }
+    return _index;
+}
+
+template <typename T>
+ProductIndex ProductRegistry<T>::At(string_view _productId) const {
+    ProductIndex _index = Find(_productId);
+    if (_index == INVALID_PRODUCT_INDEX) {
+        throw out_of_range("Unknown product " + string(_productId));
+    }
+    return _index;
+}
+
+template <typename T>
+const T& ProductRegistry<T>::Get(ProductIndex _index) const {
+    return *products[_index];
+}
+
+template <typename T>
+const shared_ptr<const T>&
+ProductRegistry<T>::GetShared(ProductIndex _index) const {
+    return products[_index];
+}
+
+template <typename T> size_t ProductRegistry<T>::GetSize() const {
+    return products.size();
+}
+
+template <typename T>
+ProductHandle<T>::ProductHandle() : index(INVALID_PRODUCT_INDEX) {}
+
+template <typename T>
+ProductHandle<T>::ProductHandle(ProductIndex _index) : index(_index) {}
+
+template <typename T>
+ProductHandle<T>::ProductHandle(const T& _product)
+    : index(GetProductIndex(_product)) {}
+
+template <typename T> const T& ProductHandle<T>::Get() const {
+    if (index == INVALID_PRODUCT_INDEX) {
+        static const T _none{};
+        return _none;
+    }
+    return GetProductRegistry<T>().Get(index);
+}
+
+template <typename T> ProductIndex ProductHandle<T>::GetIndex() const {
+    return index;
+}
+
+template <typename V> V& ProductTable<V>::operator[](ProductIndex _index) {
+    if (_index >= values.size()) {
+        values.resize(_index + 1);
+    }
+    if (!values[_index]) {
+        values[_index].emplace();
+    }
+    return *values[_index];
+}
+
+template <typename V> V* ProductTable<V>::Find(ProductIndex _index) {
+    if (_index >= values.size() || !values[_index]) {
+        return nullptr;
+    }
+    return &*values[_index];
+}
+
+template <typename V>
+const V* ProductTable<V>::Find(ProductIndex _index) const {
+    if (_index >= values.size() || !values[_index]) {
+        return nullptr;
+    }
+    return &*values[_index];
+}
+
+template <typename V>
+V& ProductTable<V>::Insert(ProductIndex _index, V _value) {
+    if (_index >= values.size()) {
+        values.resize(_index + 1);
+    }
+    values[_index] = move(_value);
+    return *values[_index];
+}
+
+long& ProductCounter::operator[](ProductIndex _index) {
+    return perProduct ? counts[_index] : total;
+}
+
+void ProductCounter::SetPerProduct(bool _perProduct) {
+    perProduct = _perProduct;
+}
+
+bool ProductCounter::IsPerProduct() const { return perProduct; }
+
+#endif
@@ -11,6 +11,7 @@
 #include <string>
 
 #include "boost/date_time/gregorian/gregorian.hpp"
+#include "cusip.hpp"
 
 using namespace std;
 using namespace boost::gregorian;
@@ -67,12 +68,15 @@ public:
   // Get the bond identifier type
   BondIdType GetBondIdType() const;
 
+  // Get the CUSIP of the bond, empty unless it is identified by CUSIP
+  const Cusip& GetCusip() const;
+
   // Print the bond
   friend ostream& operator<<(ostream &output, const Bond &bond);
 
 private:
-  string productId;
   BondIdType bondIdType;
+  Cusip cusip;
   string ticker;
   float coupon;
   date maturityDate;
@@ -179,6 +183,10 @@ ProductType Product::GetProductType() const
 Bond::Bond(string _productId, BondIdType _bondIdType, string _ticker, float _coupon, date _maturityDate) : Product(_productId, BOND)
 {
   bondIdType = _bondIdType;
+  if (_bondIdType == CUSIP)
+  {
+    Cusip::Parse(_productId, cusip);
+  }
   ticker = _ticker;
   coupon = _coupon;
   maturityDate =_maturityDate;
@@ -204,6 +212,11 @@ BondIdType Bond::GetBondIdType() const
   return bondIdType;
 }
 
+const Cusip& Bond::GetCusip() const
+{
+  return cusip;
+}
+
 ostream& operator<<(ostream &output, const Bond &bond)
 {
   output << bond.ticker << " " << bond.coupon << " " << bond.GetMaturityDate();
@@ -11,16 +11,6 @@
 #include "positionservice.hpp"
 #include "soa.hpp"
 
-// Reasonable PV01 values of the bonds
-// from the internet
-const map<string, double> bondPV01({{"91282CJL6", 0.01985},
-                                    {"91282CJK8", 0.02930},
-                                    {"91282CJN2", 0.04865},
-                                    {"91282CJM4", 0.06585},
-                                    {"91282CJJ1", 0.08741},
-                                    {"912810TW8", 0.11853},
-                                    {"912810TV0", 0.18331}});
-
 /**
  * PV01 risk.
  * Type T is the product type.
@@ -30,11 +20,14 @@ template <typename T> class PV01 {
   public:
     // ctor for a PV01 value
     PV01() = default;
-    PV01(const T& _product, double _pv01, long _quantity);
+    PV01(ProductHandle<T> _product, double _pv01, long _quantity);
 
     // Get the product on this PV01 value
     const T& GetProduct() const;
 
+    // Get the handle of the product
+    ProductHandle<T> GetProductHandle() const;
+
     // Get the PV01 value
     double GetPV01() const;
 
@@ -47,19 +40,26 @@ template <typename T> class PV01 {
     vector<string> PrintFunction() const;
 
   private:
-    T product;
+    ProductHandle<T> product;
     double pv01;
     long quantity;
 };
 
 template <typename T>
-PV01<T>::PV01(const T& _product, double _pv01, long _quantity)
+PV01<T>::PV01(ProductHandle<T> _product, double _pv01, long _quantity)
     : product(_product) {
     pv01 = _pv01;
     quantity = _quantity;
 }
 
-template <typename T> const T& PV01<T>::GetProduct() const { return product; }
+template <typename T> const T& PV01<T>::GetProduct() const {
+    return product.Get();
+}
+
+template <typename T>
+ProductHandle<T> PV01<T>::GetProductHandle() const {
+    return product;
+}
 
 template <typename T> double PV01<T>::GetPV01() const { return pv01; }
 
@@ -68,7 +68,7 @@ template <typename T> long PV01<T>::GetQuantity() const { return quantity; }
 template <typename T> void PV01<T>::SetQuantity(long _q) { quantity = _q; }
 
 template <typename T> vector<string> PV01<T>::PrintFunction() const {
-    string _product = product.GetProductId();
+    string _product = product.Get().GetProductId();
     string _pv01 = to_string(pv01);
     string _quantity = to_string(quantity);
 
@@ -117,22 +117,31 @@ template <typename T> class RiskServiceListener;
 
 /**
  * Risk Service to vend out risk for a particular security and across a risk
- * bucketed sector. Keyed on product identifier. Type T is the product type.
+ * bucketed sector. Keyed on product CUSIP. Type T is the product type.
  */
-template <typename T> class RiskService : public Service<string, PV01<T>> {
+template <typename T> class RiskService : public Service<Cusip, PV01<T>> {
   public:
     // ctor
     RiskService();
 
     // Add a position that the service will risk
+    // _emit(PV01<T>&) is handed the risk in place of the listeners.
     void AddPosition(Position<T>& position);
+    template <typename F> void AddPosition(Position<T>& position, F _emit);
+
+    // Add a batch of positions, flowing the risk to the listeners as one
+    // batch
+    void AddPositions(Position<T>* _positions, size_t _count);
 
     // Get the bucketed risk for the bucket sector
     const PV01<BucketedSector<T>>&
     GetBucketedRisk(const BucketedSector<T>& sector) const;
 
+    // Get the PV01 of the bucket sector, summed over the products held
+    double GetBucketedPV01(const BucketedSector<T>& _sector) const;
+
     // Get data from the given key
-    PV01<T>& GetData(string _key);
+    PV01<T>& GetData(Cusip _key);
 
     // Call back function receiving new data
     void OnMessage(PV01<T>& _data);
@@ -147,23 +156,22 @@ template <typename T> class RiskService : public Service<string, PV01<T>> {
     RiskServiceListener<T>* GetListener();
 
   private:
-    map<string, PV01<T>> pv01s;
+    ProductTable<PV01<T>> pv01s;
     vector<ServiceListener<PV01<T>>*> listeners;
     RiskServiceListener<T>* listener;
 };
 
 template <typename T> RiskService<T>::RiskService() {
-    pv01s = map<string, PV01<T>>();
     listeners = vector<ServiceListener<PV01<T>>*>();
     listener = new RiskServiceListener<T>(this);
 }
 
-template <typename T> PV01<T>& RiskService<T>::GetData(string _key) {
-    return pv01s[_key];
+template <typename T> PV01<T>& RiskService<T>::GetData(Cusip _key) {
+    return pv01s[GetProductRegistry<T>().At(_key)];
 }
 
 template <typename T> void RiskService<T>::OnMessage(PV01<T>& _data) {
-    pv01s[_data.GetProduct().GetProductId()] = _data;
+    pv01s.Insert(_data.GetProductHandle().GetIndex(), _data);
 }
 
 template <typename T>
@@ -181,15 +189,38 @@ template <typename T> RiskServiceListener<T>* RiskService<T>::GetListener() {
 }
 
 template <typename T> void RiskService<T>::AddPosition(Position<T>& _position) {
-    T _product = _position.GetProduct();
-    string _id = _product.GetProductId();
-    double _pv01Value = bondPV01.at(_id);
+    AddPosition(_position, ListenerEmitter<PV01<T>>(listeners));
+}
+
+template <typename T>
+template <typename F>
+void RiskService<T>::AddPosition(Position<T>& _position, F _emit) {
+    ProductHandle<T> _product = _position.GetProductHandle();
+    const BondReference* _reference = GetBondReference(_product.GetIndex());
+    if (_reference == nullptr) {
+        cerr << "Error: No PV01 for product "
+             << _product.Get().GetProductId() << endl;
+        return;
+    }
+    double _pv01Value = _reference->pv01;
     long _quantity = _position.GetAggregatePosition();
     PV01<T> _pv01(_product, _pv01Value, _quantity);
-    pv01s[_id] = _pv01;
+    pv01s.Insert(_product.GetIndex(), _pv01);
+
+    _emit(_pv01);
+}
+
+template <typename T>
+void RiskService<T>::AddPositions(Position<T>* _positions, size_t _count) {
+    vector<PV01<T>> _pv01s;
+    _pv01s.reserve(_count);
+    for (size_t i = 0; i < _count; i++) {
+        AddPosition(_positions[i],
+                    [&_pv01s](PV01<T>& _pv01) { _pv01s.push_back(_pv01); });
+    }
 
     for (auto& l : listeners) {
-        l->ProcessAdd(_pv01);
+        l->ProcessAddBatch(_pv01s.data(), _pv01s.size());
     }
 }
 
@@ -200,18 +231,36 @@ RiskService<T>::GetBucketedRisk(const BucketedSector<T>& _sector) const {
     double _pv01 = 0.0;
     long _quantity = 1;
 
-    vector<T>& _products = _sector.GetProducts();
+    const ProductRegistry<T>& _registry = GetProductRegistry<T>();
+    const vector<T>& _products = _sector.GetProducts();
 
+    // unknown products hold no risk, and are not registered from here
     for (auto& p : _products) {
-        string _pId = p.GetProductId();
-        long _q = pv01s[_pId].GetQuantity();
-        double _val = pv01s[_pId].GetPV01();
+        const PV01<T>* _risk = pv01s.Find(_registry.Find(p.GetProductId()));
+        if (_risk == nullptr) {
+            continue;
+        }
+        long _q = _risk->GetQuantity();
+        double _val = _risk->GetPV01();
         _pv01 += _val * (double)_q;
     }
 
     return PV01<BucketedSector<T>>(_product, _pv01, _quantity);
 }
 
+template <typename T>
+double RiskService<T>::GetBucketedPV01(const BucketedSector<T>& _sector) const {
+    const ProductRegistry<T>& _registry = GetProductRegistry<T>();
+    double _pv01 = 0.0;
+    for (auto& p : _sector.GetProducts()) {
+        const PV01<T>* _risk = pv01s.Find(_registry.Find(p.GetProductId()));
+        if (_risk != nullptr) {
+            _pv01 += _risk->GetPV01() * (double)_risk->GetQuantity();
+        }
+    }
+    return _pv01;
+}
+
 /**
  * Risk Service Listener
  * subscribe data from BondPositionService  to BondRiskService.
@@ -229,6 +278,10 @@ class RiskServiceListener : public ServiceListener<Position<T>> {
 
     // Listener callback to process an add event to the Service
     void ProcessAdd(Position<T>& _data);
+    template <typename F> void ProcessAdd(Position<T>& _data, F _emit);
+
+    // Listener callback to process add events for a batch of positions
+    void ProcessAddBatch(Position<T>* _data, size_t _count);
 
     // Listener callback to process a remove event to the Service
     void ProcessRemove(Position<T>& _data);
@@ -247,6 +300,18 @@ void RiskServiceListener<T>::ProcessAdd(Position<T>& _data) {
     service->AddPosition(_data);
 }
 
+template <typename T>
+template <typename F>
+void RiskServiceListener<T>::ProcessAdd(Position<T>& _data, F _emit) {
+    service->AddPosition(_data, _emit);
+}
+
+template <typename T>
+void RiskServiceListener<T>::ProcessAddBatch(Position<T>* _data,
+                                             size_t _count) {
+    service->AddPositions(_data, _count);
+}
+
 template <typename T>
 void RiskServiceListener<T>::ProcessRemove(Position<T>& _data) {}
 
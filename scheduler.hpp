@@ -0,0 +1,238 @@
+/**
+ * scheduler.hpp
+ * Defines a work-stealing scheduler running tasks on serial queues.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Tasks a worker runs from a serial queue before giving others a turn
+constexpr int SERIAL_QUEUE_BATCH = 16;
+
+// Longest a worker with nothing to run or steal sleeps before looking again
+constexpr int SCHEDULER_IDLE_MICROSECONDS = 200;
+
+/**
+ * Scheduler running tasks on a fixed set of workers, with tasks posted to
+ * serial queues. Tasks of one queue run one at a time in the order they were
+ * posted, tasks of different queues in parallel. A queue with tasks waiting
+ * is ready on the deque of one worker; workers run their own ready queues
+ * oldest first, and an idle worker steals the newest ready queue of another,
+ * so a busy key moves to an idle core as a whole, with its order intact.
+ */
+class WorkStealingScheduler {
+
+  public:
+    // ctor starting the given number of workers, at least one
+    WorkStealingScheduler(int _threads);
+
+    // Run the posted tasks, then join the workers
+    ~WorkStealingScheduler();
+
+    WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+    WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+    // Post a task to the serial queue of a key
+    void Post(size_t _key, function<void()> _task);
+
+    // Wait until every posted task has run, including tasks posted by them
+    void Drain();
+
+    // Get the number of workers
+    int GetThreadCount() const;
+
+  private:
+    // Tasks of one key, ready on at most one worker at a time
+    struct SerialQueue {
+        mutex lock;
+        deque<function<void()>> tasks;
+        // set while the queue is ready on a worker or being run
+        bool scheduled = false;
+        // the worker which last ran the queue, ready on it next time
+        size_t home = 0;
+    };
+
+    // A worker and its deque of ready queues
+    struct Worker {
+        mutex lock;
+        deque<SerialQueue*> ready;
+        thread runner;
+    };
+
+    // Get the serial queue of a key, creating it on first use
+    SerialQueue* GetQueue(size_t _key);
+
+    // Make a queue ready on a worker and wake an idle one
+    void Schedule(SerialQueue* _queue, size_t _worker);
+
+    // Take a ready queue from the worker's own deque, or steal one
+    SerialQueue* FindWork(size_t _worker);
+
+    // Run up to a batch of the queue's tasks
+    void RunQueue(SerialQueue* _queue, size_t _worker);
+
+    // Worker loop
+    void Run(size_t _worker);
+
+    vector<unique_ptr<Worker>> workers;
+    vector<unique_ptr<SerialQueue>> queues;
+    mutex queuesLock;
+    mutex idleLock;
+    condition_variable workReady;
+    atomic<uint64_t> posted;
+    atomic<uint64_t> completed;
+    atomic<bool> stopping;
+};
+
+WorkStealingScheduler::WorkStealingScheduler(int _threads)
+    : posted(0), completed(0), stopping(false) {
+    if (_threads < 1) {
+        _threads = 1;
+    }
+    for (int i = 0; i < _threads; i++) {
+        workers.emplace_back(new Worker());
+    }
+    // started once every deque exists, since workers steal from each other
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w]->runner = thread(&WorkStealingScheduler::Run, this, w);
+    }
+}
+
+WorkStealingScheduler::~WorkStealingScheduler() {
+    Drain();
+    {
+        lock_guard<mutex> _lock(idleLock);
+        stopping = true;
+    }
+    workReady.notify_all();
+    for (auto& _worker : workers) {
+        _worker->runner.join();
+    }
+}
+
+void WorkStealingScheduler::Post(size_t _key, function<void()> _task) {
+    SerialQueue* _queue = GetQueue(_key);
+    posted.fetch_add(1);
+    bool _schedule;
+    size_t _home;
+    {
+        lock_guard<mutex> _lock(_queue->lock);
+        _queue->tasks.push_back(move(_task));
+        _schedule = !_queue->scheduled;
+        _queue->scheduled = true;
+        _home = _queue->home;
+    }
+    if (_schedule) {
+        Schedule(_queue, _home);
+    }
+}
+
+void WorkStealingScheduler::Drain() {
+    while (completed.load() != posted.load()) {
+        this_thread::yield();
+    }
+}
+
+int WorkStealingScheduler::GetThreadCount() const {
+    return static_cast<int>(workers.size());
+}
+
+WorkStealingScheduler::SerialQueue*
+WorkStealingScheduler::GetQueue(size_t _key) {
+    lock_guard<mutex> _lock(queuesLock);
+    if (_key >= queues.size()) {
+        queues.resize(_key + 1);
+    }
+    if (!queues[_key]) {
+        queues[_key].reset(new SerialQueue());
+        queues[_key]->home = _key % workers.size();
+    }
+    return queues[_key].get();
+}
+
+void WorkStealingScheduler::Schedule(SerialQueue* _queue, size_t _worker) {
+    {
+        lock_guard<mutex> _lock(workers[_worker]->lock);
+        workers[_worker]->ready.push_back(_queue);
+    }
+    workReady.notify_one();
+}
+
+WorkStealingScheduler::SerialQueue*
+WorkStealingScheduler::FindWork(size_t _worker) {
+    {
+        Worker& _own = *workers[_worker];
+        lock_guard<mutex> _lock(_own.lock);
+        if (!_own.ready.empty()) {
+            SerialQueue* _queue = _own.ready.front();
+            _own.ready.pop_front();
+            return _queue;
+        }
+    }
+    for (size_t i = 1; i < workers.size(); i++) {
+        Worker& _victim = *workers[(_worker + i) % workers.size()];
+        lock_guard<mutex> _lock(_victim.lock);
+        if (!_victim.ready.empty()) {
+            SerialQueue* _queue = _victim.ready.back();
+            _victim.ready.pop_back();
+            return _queue;
+        }
+    }
+    return nullptr;
+}
+
+void WorkStealingScheduler::RunQueue(SerialQueue* _queue, size_t _worker) {
+    {
+        // a stolen queue stays with its thief
+        lock_guard<mutex> _lock(_queue->lock);
+        _queue->home = _worker;
+    }
+    for (int i = 0; i < SERIAL_QUEUE_BATCH; i++) {
+        function<void()> _task;
+        {
+            lock_guard<mutex> _lock(_queue->lock);
+            if (_queue->tasks.empty()) {
+                _queue->scheduled = false;
+                return;
+            }
+            _task = move(_queue->tasks.front());
+            _queue->tasks.pop_front();
+        }
+        _task();
+        completed.fetch_add(1);
+    }
+    // still scheduled, so no one else can have made it ready meanwhile
+    Schedule(_queue, _worker);
+}
+
+void WorkStealingScheduler::Run(size_t _worker) {
+    while (true) {
+        SerialQueue* _queue = FindWork(_worker);
+        if (_queue != nullptr) {
+            RunQueue(_queue, _worker);
+            continue;
+        }
+        unique_lock<mutex> _lock(idleLock);
+        if (stopping) {
+            return;
+        }
+        workReady.wait_for(_lock,
+                           chrono::microseconds(SCHEDULER_IDLE_MICROSECONDS));
+    }
+}
+
+#endif
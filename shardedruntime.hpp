@@ -0,0 +1,373 @@
+/**
+ * shardedruntime.hpp
+ * Defines a runtime partitioning products across shards of the pipeline,
+ * which run on threads of their own or on a work-stealing scheduler.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef SHARDED_RUNTIME_HPP
+#define SHARDED_RUNTIME_HPP
+
+#include "AlgoExecutionService.hpp"
+#include "AlgoStreamingService.hpp"
+#include "asyncpipeline.hpp"
+#include "executionservice.hpp"
+#include "inquiryservice.hpp"
+#include "mappedfile.hpp"
+#include "marketdataservice.hpp"
+#include "positionservice.hpp"
+#include "pricingservice.hpp"
+#include "riskservice.hpp"
+#include "scheduler.hpp"
+#include "streamingservice.hpp"
+#include "tradebookingservice.hpp"
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Bytes of lines gathered for a shard before they are handed to it
+constexpr size_t SHARD_CHUNK_SIZE = 1 << 16;
+
+// Input feeds which are routed to the shards
+enum ShardFeed { PRICE_FEED, MARKET_DATA_FEED, TRADE_FEED, INQUIRY_FEED };
+
+/**
+ * Lines of one feed routed to a shard, in the order of the input file.
+ */
+struct ShardInput {
+    ShardFeed feed;
+    string lines;
+};
+
+/**
+ * Listener merging the data of every shard into one listener downstream,
+ * for a service shared by all shards. The data of each call is handed on
+ * under a lock, so a batch reaches the listener in one piece, and the data
+ * of one shard stays in order.
+ * Type V is the data type.
+ */
+template <typename V> class MergePoint : public ServiceListener<V> {
+
+  public:
+    // ctor for a merge point in front of a listener
+    MergePoint(ServiceListener<V>* _listener);
+
+    // Listener callback to process an add event to the Service
+    void ProcessAdd(V& _data);
+
+    // Listener callback to process a remove event to the Service
+    void ProcessRemove(V& _data);
+
+    // Listener callback to process an update event to the Service
+    void ProcessUpdate(V& _data);
+
+    // Listener callback to process add events for a batch of data
+    void ProcessAddBatch(V* _data, size_t _count);
+
+  private:
+    ServiceListener<V>* listener;
+    mutex lock;
+};
+
+/**
+ * A shard of the pipeline, owning the services for the products routed to
+ * it and listening for the lines of those products. Services shared by all
+ * shards are reached through merge points.
+ * Type T is the product type.
+ */
+template <typename T> class PipelineShard : public ServiceListener<ShardInput> {
+
+  public:
+    // ctor for a shard, wired to the merge points of the shared services
+    PipelineShard(ServiceListener<Price<T>>* _gui,
+                  ServiceListener<PriceStream<T>>* _streams,
+                  ServiceListener<ExecutionOrder<T>>* _executions,
+                  ServiceListener<Position<T>>* _positions,
+                  ServiceListener<PV01<T>>* _risk,
+                  ServiceListener<Inquiry<T>>* _inquiries);
+
+    // Listener callback to process the lines routed to the shard
+    void ProcessAdd(ShardInput& _data);
+
+    // Listener callback to process a remove event to the Service
+    void ProcessRemove(ShardInput& _data);
+
+    // Listener callback to process an update event to the Service
+    void ProcessUpdate(ShardInput& _data);
+
+    // Get the risk service of the shard
+    const RiskService<T>& GetRiskService() const;
+
+    // Get the market data service of the shard
+    const MarketDataService<T>& GetMarketDataService() const;
+
+  private:
+    MarketDataService<T> marketDataService;
+    PricingService<T> pricingService;
+    TradeBookingService<T> tradeBookingService;
+    PositionService<T> positionService;
+    RiskService<T> riskService;
+    AlgoExecutionService<T> algoExecutionService;
+    AlgoStreamingService<T> algoStreamingService;
+    ExecutionService<T> executionService;
+    StreamingService<T> streamingService;
+    InquiryService<T> inquiryService;
+};
+
+/**
+ * Runtime partitioning products by ProductIndex across shards of the
+ * pipeline. Lines of the input feeds are routed to the shard owning their
+ * product, so every product is handled in file order by one thread at a
+ * time, and shards share no state.
+ * Each shard runs on a thread of its own, or with a scheduler, as a serial
+ * queue of it. Given a shard per product, the scheduler's workers can then
+ * take over busy products from each other.
+ * Counters kept by a service, such as algo order ids, run per product, so
+ * the output is the same for any number of shards. Algo order ids are then
+ * qualified by CUSIP to stay unique.
+ * Type T is the product type.
+ */
+template <typename T> class ShardedRuntime {
+
+  public:
+    // ctor for a runtime of _shards shards, merging into the listeners of
+    // the shared GUI and historical data services. The shards run on the
+    // scheduler if one is given, else each on a thread of its own.
+    ShardedRuntime(int _shards, ServiceListener<Price<T>>* _gui,
+                   ServiceListener<PriceStream<T>>* _streams,
+                   ServiceListener<ExecutionOrder<T>>* _executions,
+                   ServiceListener<Position<T>>* _positions,
+                   ServiceListener<PV01<T>>* _risk,
+                   ServiceListener<Inquiry<T>>* _inquiries,
+                   WorkStealingScheduler* _scheduler = nullptr);
+
+    // Route the lines of a feed to the shards owning their products
+    void Subscribe(const MappedFile& _data, ShardFeed _feed);
+
+    // Wait until the shards have processed everything routed to them
+    void Drain();
+
+    // Get the PV01 of a bucketed sector, summed over the shards.
+    // Call once drained.
+    double GetBucketedPV01(const BucketedSector<T>& _sector) const;
+
+    // Get the number of levels dropped by full order books, summed over the
+    // shards. Call once drained.
+    long GetDroppedLevels() const;
+
+    // Get the number of shards
+    int GetShardCount() const;
+
+  private:
+    // Hand the lines gathered for a shard to it
+    void FlushLines(size_t _shard, ShardFeed _feed);
+
+    MergePoint<Price<T>> guiMerge;
+    MergePoint<PriceStream<T>> streamMerge;
+    MergePoint<ExecutionOrder<T>> executionMerge;
+    MergePoint<Position<T>> positionMerge;
+    MergePoint<PV01<T>> riskMerge;
+    MergePoint<Inquiry<T>> inquiryMerge;
+    WorkStealingScheduler* scheduler;
+    vector<unique_ptr<PipelineShard<T>>> shards;
+    vector<ServiceListener<ShardInput>*> inputs;
+    vector<string> pending;
+    // last, so the workers stop before the shards go
+    AsyncPipeline pipeline;
+};
+
+template <typename V>
+MergePoint<V>::MergePoint(ServiceListener<V>* _listener)
+    : listener(_listener) {}
+
+template <typename V> void MergePoint<V>::ProcessAdd(V& _data) {
+    lock_guard<mutex> _guard(lock);
+    listener->ProcessAdd(_data);
+}
+
+template <typename V> void MergePoint<V>::ProcessRemove(V& _data) {}
+
+template <typename V> void MergePoint<V>::ProcessUpdate(V& _data) {}
+
+template <typename V>
+void MergePoint<V>::ProcessAddBatch(V* _data, size_t _count) {
+    lock_guard<mutex> _guard(lock);
+    listener->ProcessAddBatch(_data, _count);
+}
+
+template <typename T>
+PipelineShard<T>::PipelineShard(ServiceListener<Price<T>>* _gui,
+                                ServiceListener<PriceStream<T>>* _streams,
+                                ServiceListener<ExecutionOrder<T>>* _executions,
+                                ServiceListener<Position<T>>* _positions,
+                                ServiceListener<PV01<T>>* _risk,
+                                ServiceListener<Inquiry<T>>* _inquiries) {
+    pricingService.AddListener(_gui);
+    pricingService.AddListener(algoStreamingService.GetListener());
+    algoStreamingService.AddListener(streamingService.GetListener());
+    streamingService.AddListener(_streams);
+    marketDataService.AddListener(algoExecutionService.GetListener());
+    algoExecutionService.AddListener(executionService.GetListener());
+    executionService.AddListener(_executions);
+    executionService.AddListener(tradeBookingService.GetListener());
+    tradeBookingService.AddListener(positionService.GetListener());
+    positionService.AddListener(riskService.GetListener());
+    positionService.AddListener(_positions);
+    riskService.AddListener(_risk);
+    inquiryService.AddListener(_inquiries);
+
+    // a shard sees only its products, so it numbers each of them on its own
+    marketDataService.GetConnector()->SetCountPerProduct(true);
+    algoExecutionService.SetCountPerProduct(true);
+    algoStreamingService.SetCountPerProduct(true);
+    tradeBookingService.GetListener()->SetCountPerProduct(true);
+}
+
+template <typename T> void PipelineShard<T>::ProcessAdd(ShardInput& _data) {
+    LineSource _lines(_data.lines.data(),
+                      _data.lines.data() + _data.lines.size());
+    switch (_data.feed) {
+    case PRICE_FEED:
+        pricingService.GetConnector()->Subscribe(_lines);
+        break;
+    case MARKET_DATA_FEED:
+        marketDataService.GetConnector()->Subscribe(_lines);
+        break;
+    case TRADE_FEED:
+        tradeBookingService.GetConnector()->Subscribe(_lines);
+        break;
+    case INQUIRY_FEED:
+        inquiryService.GetConnector()->Subscribe(_lines);
+        break;
+    }
+}
+
+template <typename T>
+void PipelineShard<T>::ProcessRemove(ShardInput& _data) {}
+
+template <typename T>
+void PipelineShard<T>::ProcessUpdate(ShardInput& _data) {}
+
+template <typename T>
+const RiskService<T>& PipelineShard<T>::GetRiskService() const {
+    return riskService;
+}
+
+template <typename T>
+const MarketDataService<T>& PipelineShard<T>::GetMarketDataService() const {
+    return marketDataService;
+}
+
+template <typename T>
+ShardedRuntime<T>::ShardedRuntime(
+    int _shards, ServiceListener<Price<T>>* _gui,
+    ServiceListener<PriceStream<T>>* _streams,
+    ServiceListener<ExecutionOrder<T>>* _executions,
+    ServiceListener<Position<T>>* _positions, ServiceListener<PV01<T>>* _risk,
+    ServiceListener<Inquiry<T>>* _inquiries, WorkStealingScheduler* _scheduler)
+    : guiMerge(_gui), streamMerge(_streams), executionMerge(_executions),
+      positionMerge(_positions), riskMerge(_risk), inquiryMerge(_inquiries),
+      scheduler(_scheduler), shards(), inputs(), pending(_shards),
+      pipeline(_scheduler == nullptr) {
+    for (int i = 0; i < _shards; i++) {
+        shards.emplace_back(new PipelineShard<T>(
+            &guiMerge, &streamMerge, &executionMerge, &positionMerge,
+            &riskMerge, &inquiryMerge));
+        inputs.push_back(pipeline.Stage<ShardInput>(shards.back().get()));
+    }
+}
+
+template <typename T>
+void ShardedRuntime<T>::Subscribe(const MappedFile& _data, ShardFeed _feed) {
+    const ProductRegistry<T>& _registry = GetProductRegistry<T>();
+    const char* _next = _data.GetData();
+    const char* _end = _next + _data.GetSize();
+    // inquiries lead with their own id, the product follows
+    int _skip = _feed == INQUIRY_FEED ? 1 : 0;
+    while (_next != _end) {
+        const char* _lineEnd =
+            static_cast<const char*>(memchr(_next, '\n', _end - _next));
+        _lineEnd = _lineEnd != nullptr ? _lineEnd + 1 : _end;
+        const char* _field = _next;
+        for (int i = 0; i < _skip && _field != _lineEnd; i++) {
+            const char* _comma = static_cast<const char*>(
+                memchr(_field, ',', _lineEnd - _field));
+            _field = _comma != nullptr ? _comma + 1 : _lineEnd;
+        }
+        const char* _comma =
+            static_cast<const char*>(memchr(_field, ',', _lineEnd - _field));
+        string_view _productId(_field, (_comma != nullptr ? _comma : _lineEnd) -
+                                           _field);
+
+        // lines of unknown products go to the first shard to be reported
+        ProductIndex _index = _registry.Find(_productId);
+        size_t _shard =
+            _index == INVALID_PRODUCT_INDEX ? 0 : _index % shards.size();
+        string& _lines = pending[_shard];
+        _lines.append(_next, _lineEnd);
+        if (_lines.back() != '\n') {
+            _lines.push_back('\n');
+        }
+        if (_lines.size() >= SHARD_CHUNK_SIZE) {
+            FlushLines(_shard, _feed);
+        }
+        _next = _lineEnd;
+    }
+
+    for (size_t s = 0; s < shards.size(); s++) {
+        FlushLines(s, _feed);
+    }
+}
+
+template <typename T> void ShardedRuntime<T>::Drain() {
+    if (scheduler != nullptr) {
+        scheduler->Drain();
+    }
+    pipeline.Drain();
+}
+
+template <typename T>
+double
+ShardedRuntime<T>::GetBucketedPV01(const BucketedSector<T>& _sector) const {
+    double _pv01 = 0.0;
+    for (auto& _shard : shards) {
+        _pv01 += _shard->GetRiskService().GetBucketedPV01(_sector);
+    }
+    return _pv01;
+}
+
+template <typename T> long ShardedRuntime<T>::GetDroppedLevels() const {
+    long _dropped = 0;
+    for (auto& _shard : shards) {
+        _dropped += _shard->GetMarketDataService().GetDroppedLevels();
+    }
+    return _dropped;
+}
+
+template <typename T> int ShardedRuntime<T>::GetShardCount() const {
+    return static_cast<int>(shards.size());
+}
+
+template <typename T>
+void ShardedRuntime<T>::FlushLines(size_t _shard, ShardFeed _feed) {
+    if (pending[_shard].empty()) {
+        return;
+    }
+    ShardInput _input{_feed, move(pending[_shard])};
+    if (scheduler != nullptr) {
+        PipelineShard<T>* _target = shards[_shard].get();
+        // the chunk is moved into the task, which the scheduler moves on
+        scheduler->Post(_shard, [_target, _input = move(_input)]() mutable {
+            _target->ProcessAdd(_input);
+        });
+    } else {
+        inputs[_shard]->ProcessAdd(_input);
+    }
+    pending[_shard].clear();
+}
+
+#endif
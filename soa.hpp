@@ -13,11 +13,15 @@
 #include <vector>
 #include <map>
 #include <unordered_map>
+#include "mappedfile.hpp"
 #include "products.hpp"
 #include "utility.hpp"
 
 using namespace std;
 
+// Items a Connector gathers before pushing them to its Service as one batch
+constexpr size_t CONNECTOR_BATCH_SIZE = 1024;
+
 /**
 * Definition of a generic base class ServiceListener to listen to add, update, and remove
 * events on a Service. This listener should be registered on a Service for the Service
@@ -38,6 +42,47 @@ public:
 	// Listener callback to process an update event to the Service
 	virtual void ProcessUpdate(V& _data) = 0;
 
+	// Listener callback to process add events for a batch of contiguous data.
+	// Listeners which can amortize work over a batch override it; by default
+	// each item is processed in turn.
+	virtual void ProcessAddBatch(V* _data, size_t _count)
+	{
+		for (size_t i = 0; i < _count; i++)
+		{
+			ProcessAdd(_data[i]);
+		}
+	}
+
+};
+
+/**
+* Emitter handing data to every listener registered on a Service at run time.
+* Services and listeners which pass their output on through an emitter take
+* this one on the runtime path, and a typed node of a static listener graph
+* in its place (see staticgraph.hpp).
+*/
+template<typename V>
+class ListenerEmitter
+{
+
+public:
+
+	// ctor for an emitter over the listeners of a Service
+	ListenerEmitter(const vector<ServiceListener<V>*>& _listeners) : listeners(_listeners) {}
+
+	// Hand an add event to each listener
+	void operator()(V& _data) const
+	{
+		for (auto& l : listeners)
+		{
+			l->ProcessAdd(_data);
+		}
+	}
+
+private:
+
+	const vector<ServiceListener<V>*>& listeners;
+
 };
 
 /**
@@ -81,8 +126,22 @@ public:
 	// Publish data to the Connector
 	virtual void Publish(V& _data) = 0;
 
+	// Publish a batch of contiguous data to the Connector
+	// By default each item is published in turn
+	virtual void PublishBatch(V* _data, size_t _count)
+	{
+		for (size_t i = 0; i < _count; i++)
+		{
+			Publish(_data[i]);
+		}
+	}
+
 	// Subscribe data from the Connector
 	virtual void Subscribe(ifstream& _data) = 0;
+
+	// Subscribe data from lines of a memory mapped source
+	// Publish-only Connectors ignore it
+	virtual void Subscribe(LineSource& _data) {}
 };
 
 #endif
@@ -0,0 +1,106 @@
+/**
+ * spscring.hpp
+ * Defines a bounded lock-free ring between one producer and one consumer.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+// Bytes of a cache line, keeping the two ends of a ring apart
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * Bounded ring buffer passing values from a single producer thread to a
+ * single consumer thread without locks. Each end owns one index and only
+ * reads the other, keeping a cached copy of it so that most calls touch no
+ * shared cache line.
+ * Producers may change only while the ring is empty and the handover is
+ * ordered by other means, e.g. by waiting for the ring to drain.
+ * Type V is the value type, which must be default constructible.
+ */
+template <typename V> class SpscRing {
+
+  public:
+    // ctor for a ring holding at least _capacity values
+    SpscRing(size_t _capacity);
+
+    // Copy a value into the ring, false if it is full
+    bool TryPush(const V& _data);
+
+    // Move the oldest value out of the ring, false if it is empty
+    bool TryPop(V& _data);
+
+    // Get the number of values the ring holds
+    size_t GetCapacity() const;
+
+    // Get the number of values in the ring, as last seen by the caller
+    size_t GetSize() const;
+
+  private:
+    vector<V> slots;
+    size_t mask;
+
+    // next slot to pop, written by the consumer only
+    alignas(CACHE_LINE_SIZE) atomic<size_t> head;
+    size_t cachedTail;
+
+    // next slot to push, written by the producer only
+    alignas(CACHE_LINE_SIZE) atomic<size_t> tail;
+    size_t cachedHead;
+};
+
+template <typename V>
+SpscRing<V>::SpscRing(size_t _capacity)
+    : head(0), cachedTail(0), tail(0), cachedHead(0) {
+    size_t _size = 1;
+    while (_size < _capacity) {
+        _size <<= 1;
+    }
+    slots.resize(_size);
+    mask = _size - 1;
+}
+
+template <typename V> bool SpscRing<V>::TryPush(const V& _data) {
+    size_t _tail = tail.load(memory_order_relaxed);
+    if (_tail - cachedHead == slots.size()) {
+        cachedHead = head.load(memory_order_acquire);
+        if (_tail - cachedHead == slots.size()) {
+            return false;
+        }
+    }
+    slots[_tail & mask] = _data;
+    tail.store(_tail + 1, memory_order_release);
+    return true;
+}
+
+template <typename V> bool SpscRing<V>::TryPop(V& _data) {
+    size_t _head = head.load(memory_order_relaxed);
+    if (_head == cachedTail) {
+        cachedTail = tail.load(memory_order_acquire);
+        if (_head == cachedTail) {
+            return false;
+        }
+    }
+    _data = move(slots[_head & mask]);
+    head.store(_head + 1, memory_order_release);
+    return true;
+}
+
+template <typename V> size_t SpscRing<V>::GetCapacity() const {
+    return slots.size();
+}
+
+template <typename V> size_t SpscRing<V>::GetSize() const {
+    // head is read first, so it never runs ahead of tail
+    size_t _head = head.load(memory_order_acquire);
+    return tail.load(memory_order_acquire) - _head;
+}
+
+#endif
@@ -0,0 +1,104 @@
+/**
+ * staticgraph.hpp
+ * Defines listener graphs wired at compile time instead of at run time.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef STATIC_GRAPH_HPP
+#define STATIC_GRAPH_HPP
+
+#include "soa.hpp"
+#include <tuple>
+
+using namespace std;
+
+/**
+ * Node of a listener graph wired at compile time. Data added to the node goes
+ * to its listener, and whatever the listener passes on goes to each node
+ * downstream in the order they were given, as it would go to listeners
+ * registered on the service in that order.
+ * Listeners and nodes are called through their concrete types, so the graph
+ * below a node compiles to direct calls which can be inlined.
+ * A listener with nodes downstream needs a ProcessAdd(V&, F _emit) overload
+ * handing its output to _emit; a listener without is called on ProcessAdd(V&).
+ * Type L is the listener type, types N are the downstream node types.
+ */
+template <typename L, typename... N> class StaticNode {
+
+  public:
+    // ctor for a node over a listener and the nodes downstream of it
+    StaticNode(L& _listener, N... _next);
+
+    // Process an add event through the listener and the nodes downstream
+    template <typename V> void operator()(V& _data);
+
+  private:
+    L& listener;
+    tuple<N...> next;
+};
+
+/**
+ * Listener at the root of a static graph, registered on a service like any
+ * other listener. The service reaches it with one virtual call, after which
+ * the graph runs on direct calls.
+ * Type V is the data type, type G the type of the root node of the graph.
+ */
+template <typename V, typename G>
+class StaticListener : public ServiceListener<V> {
+
+  public:
+    // ctor for a listener over the root node of a graph
+    StaticListener(G _graph);
+
+    // Listener callback to process an add event to the Service
+    void ProcessAdd(V& _data);
+
+    // Listener callback to process a remove event to the Service
+    void ProcessRemove(V& _data);
+
+    // Listener callback to process an update event to the Service
+    void ProcessUpdate(V& _data);
+
+  private:
+    G graph;
+};
+
+// Wire a listener to the nodes downstream of it
+template <typename L, typename... N>
+StaticNode<L, N...> Wire(L* _listener, N... _next) {
+    return StaticNode<L, N...>(*_listener, _next...);
+}
+
+template <typename L, typename... N>
+StaticNode<L, N...>::StaticNode(L& _listener, N... _next)
+    : listener(_listener), next(_next...) {}
+
+template <typename L, typename... N>
+template <typename V>
+void StaticNode<L, N...>::operator()(V& _data) {
+    if constexpr (sizeof...(N) == 0) {
+        // qualified, so the call is bound statically
+        listener.L::ProcessAdd(_data);
+    } else {
+        listener.ProcessAdd(_data, [this](auto& _output) {
+            apply([&_output](auto&... _nodes) { (_nodes(_output), ...); },
+                  next);
+        });
+    }
+}
+
+template <typename V, typename G>
+StaticListener<V, G>::StaticListener(G _graph) : graph(_graph) {}
+
+template <typename V, typename G>
+void StaticListener<V, G>::ProcessAdd(V& _data) {
+    graph(_data);
+}
+
+template <typename V, typename G>
+void StaticListener<V, G>::ProcessRemove(V& _data) {}
+
+template <typename V, typename G>
+void StaticListener<V, G>::ProcessUpdate(V& _data) {}
+
+#endif
@@ -18,14 +18,14 @@ class PriceStreamOrder {
   public:
     // ctor for an order
     PriceStreamOrder() = default;
-    PriceStreamOrder(double _price, long _visibleQuantity, long _hiddenQuantity,
+    PriceStreamOrder(TickPrice _price, long _visibleQuantity, long _hiddenQuantity,
                      PricingSide _side);
 
     // The side on this order
     PricingSide GetSide() const;
 
     // Get the price on this order
-    double GetPrice() const;
+    TickPrice GetPrice() const;
 
     // Get the visible quantity on this order
     long GetVisibleQuantity() const;
@@ -36,7 +36,7 @@ class PriceStreamOrder {
     vector<string> PrintFunction() const;
 
   private:
-    double price;
+    TickPrice price;
     long visibleQuantity;
     long hiddenQuantity;
     PricingSide side;
@@ -51,12 +51,15 @@ template <typename T> class PriceStream {
   public:
     // ctor
     PriceStream() = default;
-    PriceStream(const T& _product, const PriceStreamOrder& _bidOrder,
+    PriceStream(ProductHandle<T> _product, const PriceStreamOrder& _bidOrder,
                 const PriceStreamOrder& _offerOrder);
 
     // Get the product
     const T& GetProduct() const;
 
+    // Get the handle of the product
+    ProductHandle<T> GetProductHandle() const;
+
     // Get the bid order
     const PriceStreamOrder& GetBidOrder() const;
 
@@ -66,12 +69,12 @@ template <typename T> class PriceStream {
     vector<string> PrintFunction() const;
 
   private:
-    T product;
+    ProductHandle<T> product;
     PriceStreamOrder bidOrder;
     PriceStreamOrder offerOrder;
 };
 
-PriceStreamOrder::PriceStreamOrder(double _price, long _visibleQuantity,
+PriceStreamOrder::PriceStreamOrder(TickPrice _price, long _visibleQuantity,
                                    long _hiddenQuantity, PricingSide _side) {
     price = _price;
     visibleQuantity = _visibleQuantity;
@@ -79,7 +82,7 @@ PriceStreamOrder::PriceStreamOrder(double _price, long _visibleQuantity,
     side = _side;
 }
 
-double PriceStreamOrder::GetPrice() const { return price; }
+TickPrice PriceStreamOrder::GetPrice() const { return price; }
 
 long PriceStreamOrder::GetVisibleQuantity() const { return visibleQuantity; }
 
@@ -95,12 +98,17 @@ vector<string> PriceStreamOrder::PrintFunction() const {
 }
 
 template <typename T>
-PriceStream<T>::PriceStream(const T& _product,
+PriceStream<T>::PriceStream(ProductHandle<T> _product,
                             const PriceStreamOrder& _bidOrder,
                             const PriceStreamOrder& _offerOrder)
     : product(_product), bidOrder(_bidOrder), offerOrder(_offerOrder) {}
 
 template <typename T> const T& PriceStream<T>::GetProduct() const {
+    return product.Get();
+}
+
+template <typename T>
+ProductHandle<T> PriceStream<T>::GetProductHandle() const {
     return product;
 }
 
@@ -115,7 +123,7 @@ const PriceStreamOrder& PriceStream<T>::GetOfferOrder() const {
 }
 
 template <typename T> vector<string> PriceStream<T>::PrintFunction() const {
-    string _product = product.GetProductId();
+    string _product = product.Get().GetProductId();
     vector<string> _bidOrder = bidOrder.PrintFunction();
     vector<string> _offerOrder = offerOrder.PrintFunction();
 
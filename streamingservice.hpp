@@ -18,11 +18,11 @@ class StreamingServiceListener;
 
 /**
  * Streaming service to publish two-way prices.
- * Keyed on product identifier.
+ * Keyed on product CUSIP, held by product index.
  * Type T is the product type.
  */
 template<typename T>
-class StreamingService : public Service<string,PriceStream <T> >
+class StreamingService : public Service<Cusip,PriceStream <T> >
 {
 
 public:
@@ -31,7 +31,7 @@ public:
     StreamingService();
 
     // Get data on our service given a key
-    PriceStream<T>& GetData(string _key);
+    PriceStream<T>& GetData(Cusip _key);
 
     // The callback that a Connector should invoke for any new or updated data
     void OnMessage(PriceStream<T>& _data);
@@ -48,9 +48,12 @@ public:
     // Publish two-way prices
     void PublishPrice(PriceStream<T>& _priceStream);
 
+    // Publish a batch of two-way prices to the listeners as one batch
+    void PublishPrices(PriceStream<T>* _priceStreams, size_t _count);
+
 private:
 
-    map<string, PriceStream<T>> priceStreams;
+    ProductTable<PriceStream<T>> priceStreams;
     vector<ServiceListener<PriceStream<T>>*> listeners;
     ServiceListener<AlgoStream<T>>* listener;
 };
@@ -58,21 +61,20 @@ private:
 template<typename T>
 StreamingService<T>::StreamingService()
 {
-    priceStreams = map<string, PriceStream<T>>();
     listeners = vector<ServiceListener<PriceStream<T>>*>();
     listener = new StreamingServiceListener<T>(this);
 }
 
 template<typename T>
-PriceStream<T>& StreamingService<T>::GetData(string _key)
+PriceStream<T>& StreamingService<T>::GetData(Cusip _key)
 {
-    return priceStreams[_key];
+    return priceStreams[GetProductRegistry<T>().At(_key)];
 }
 
 template<typename T>
 void StreamingService<T>::OnMessage(PriceStream<T>& _data)
 {
-    priceStreams[_data.GetProduct().GetProductId()] = _data;
+    priceStreams.Insert(_data.GetProductHandle().GetIndex(), _data);
 }
 
 template<typename T>
@@ -102,6 +104,15 @@ void StreamingService<T>::PublishPrice(PriceStream<T>& _priceStream)
     }
 }
 
+template<typename T>
+void StreamingService<T>::PublishPrices(PriceStream<T>* _priceStreams, size_t _count)
+{
+    for (auto& l : listeners)
+    {
+        l->ProcessAddBatch(_priceStreams, _count);
+    }
+}
+
 /**
 * Service Listener subscribing data from BondAlgoExecutionService
 * Type T is the product type.
@@ -118,6 +129,9 @@ public:
     // Listener callback to process an add event to the Service
     void ProcessAdd(AlgoStream<T>& _data);
 
+    // Listener callback to process add events for a batch of algo streams
+    void ProcessAddBatch(AlgoStream<T>* _data, size_t _count);
+
     // Listener callback to process a remove event to the Service
     void ProcessRemove(AlgoStream<T>& _data);
     
@@ -147,6 +161,20 @@ void StreamingServiceListener<T>::ProcessAdd(AlgoStream<T>& _data)
     service->PublishPrice(*_priceStream);
 }
 
+template<typename T>
+void StreamingServiceListener<T>::ProcessAddBatch(AlgoStream<T>* _data, size_t _count)
+{
+    vector<PriceStream<T>> _priceStreams;
+    _priceStreams.reserve(_count);
+    for (size_t i = 0; i < _count; i++)
+    {
+        PriceStream<T>* _priceStream = _data[i].GetPriceStream();
+        service->OnMessage(*_priceStream);
+        _priceStreams.push_back(*_priceStream);
+    }
+    service->PublishPrices(_priceStreams.data(), _priceStreams.size());
+}
+
 template<typename T>
 void StreamingServiceListener<T>::ProcessRemove(AlgoStream<T>& _data) {}
 
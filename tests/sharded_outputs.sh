@@ -0,0 +1,42 @@
+#!/bin/sh
+# sharded_outputs.sh
+# Checks that --shards and --work-stealing write the same executions and
+# positions for any number of shards or threads, given the same inputs.
+# --shards 1 is the reference. Timestamps are
+# dropped, and the lines of each product are compared in the order written,
+# since the sharded runs interleave the products differently.
+#
+# Usage: sharded_outputs.sh path/to/trade
+
+set -e
+
+trade=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cd "$dir"
+mkdir -p Data/Input Data/Output
+
+# Lines of a historical data file without timestamps, grouped by product
+normalize() {
+    cut -d, -f2- "$1" | LC_ALL=C sort -s -t, -k1,1
+}
+
+"$trade" --shards 1 > /dev/null
+mkdir expected
+for f in executions.txt positions.txt; do
+    normalize "Data/Output/$f" > "expected/$f"
+done
+
+for mode in "--shards 3" "--work-stealing 4"; do
+    rm -f Data/Output/*
+    "$trade" --reuse-inputs $mode > /dev/null
+    for f in executions.txt positions.txt; do
+        normalize "Data/Output/$f" > actual
+        if ! cmp -s "expected/$f" actual; then
+            echo "$f differs with $mode:"
+            diff "expected/$f" actual | head -n 10
+            exit 1
+        fi
+    done
+    echo "$mode: executions.txt and positions.txt match"
+done
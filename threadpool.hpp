@@ -0,0 +1,108 @@
+/**
+ * threadpool.hpp
+ * Defines a fixed-size pool of worker threads running submitted tasks.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Pool of worker threads taking tasks from a shared FIFO queue.
+ */
+class ThreadPool {
+
+  public:
+    // ctor starting the given number of workers, at least one
+    ThreadPool(int _threads);
+
+    // Finish the queued tasks and join the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task, the future holds its result
+    template <typename F> future<decltype(declval<F>()())> Submit(F _task);
+
+    // Get the number of workers
+    int GetThreadCount() const;
+
+  private:
+    // Worker loop
+    void Run();
+
+    vector<thread> workers;
+    deque<function<void()>> tasks;
+    mutex tasksMutex;
+    condition_variable tasksReady;
+    bool stopping;
+};
+
+ThreadPool::ThreadPool(int _threads) : stopping(false) {
+    if (_threads < 1) {
+        _threads = 1;
+    }
+    for (int i = 0; i < _threads; i++) {
+        workers.emplace_back(&ThreadPool::Run, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> _lock(tasksMutex);
+        stopping = true;
+    }
+    tasksReady.notify_all();
+    for (auto& _worker : workers) {
+        _worker.join();
+    }
+}
+
+template <typename F>
+future<decltype(declval<F>()())> ThreadPool::Submit(F _task) {
+    typedef decltype(declval<F>()()) R;
+    // packaged_task is move-only, std::function needs a copyable callable
+    auto _packaged = make_shared<packaged_task<R()>>(move(_task));
+    future<R> _result = _packaged->get_future();
+    {
+        lock_guard<mutex> _lock(tasksMutex);
+        tasks.emplace_back([_packaged]() { (*_packaged)(); });
+    }
+    tasksReady.notify_one();
+    return _result;
+}
+
+int ThreadPool::GetThreadCount() const {
+    return static_cast<int>(workers.size());
+}
+
+void ThreadPool::Run() {
+    while (true) {
+        function<void()> _task;
+        {
+            unique_lock<mutex> _lock(tasksMutex);
+            tasksReady.wait(_lock,
+                            [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            _task = move(tasks.front());
+            tasks.pop_front();
+        }
+        _task();
+    }
+}
+
+#endif
@@ -0,0 +1,100 @@
+/**
+ * tickprice.hpp
+ * Defines the fixed-point price type for US Treasuries.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef TICK_PRICE_HPP
+#define TICK_PRICE_HPP
+
+#include <cstdint>
+#include <functional>
+
+// Treasuries are quoted in 32nds with a 1/8 digit, so one point is 256 ticks
+constexpr int64_t TICKS_PER_POINT = 256;
+
+/**
+ * A Treasury price held as an integer count of 1/256 ticks.
+ * Arithmetic, comparison and hashing are exact.
+ */
+class TickPrice {
+
+  public:
+    // ctor for a price, given in ticks
+    constexpr TickPrice() : ticks(0) {}
+    constexpr explicit TickPrice(int64_t _ticks) : ticks(_ticks) {}
+
+    // Get the number of ticks
+    constexpr int64_t GetTicks() const { return ticks; }
+
+    // Get the price as a decimal number of points
+    double ToDecimal() const;
+
+    TickPrice& operator+=(TickPrice _other);
+    TickPrice& operator-=(TickPrice _other);
+
+  private:
+    int64_t ticks;
+};
+
+double TickPrice::ToDecimal() const {
+    return static_cast<double>(ticks) / TICKS_PER_POINT;
+}
+
+TickPrice& TickPrice::operator+=(TickPrice _other) {
+    ticks += _other.ticks;
+    return *this;
+}
+
+TickPrice& TickPrice::operator-=(TickPrice _other) {
+    ticks -= _other.ticks;
+    return *this;
+}
+
+constexpr TickPrice operator+(TickPrice a, TickPrice b) {
+    return TickPrice(a.GetTicks() + b.GetTicks());
+}
+
+constexpr TickPrice operator-(TickPrice a, TickPrice b) {
+    return TickPrice(a.GetTicks() - b.GetTicks());
+}
+
+constexpr TickPrice operator-(TickPrice a) { return TickPrice(-a.GetTicks()); }
+
+constexpr TickPrice operator*(TickPrice a, int64_t n) {
+    return TickPrice(a.GetTicks() * n);
+}
+
+constexpr bool operator==(TickPrice a, TickPrice b) {
+    return a.GetTicks() == b.GetTicks();
+}
+
+constexpr bool operator!=(TickPrice a, TickPrice b) {
+    return a.GetTicks() != b.GetTicks();
+}
+
+constexpr bool operator<(TickPrice a, TickPrice b) {
+    return a.GetTicks() < b.GetTicks();
+}
+
+constexpr bool operator<=(TickPrice a, TickPrice b) {
+    return a.GetTicks() <= b.GetTicks();
+}
+
+constexpr bool operator>(TickPrice a, TickPrice b) {
+    return a.GetTicks() > b.GetTicks();
+}
+
+constexpr bool operator>=(TickPrice a, TickPrice b) {
+    return a.GetTicks() >= b.GetTicks();
+}
+
+namespace std {
+template <> struct hash<TickPrice> {
+    size_t operator()(TickPrice _price) const {
+        return hash<int64_t>()(_price.GetTicks());
+    }
+};
+} // namespace std
+
+#endif
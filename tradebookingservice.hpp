@@ -10,6 +10,7 @@
 
 #include <string>
 #include <vector>
+#include "soa.hpp"
 #include "utility.hpp"
 
 // Trade sides
@@ -24,17 +25,20 @@ template <typename T> class Trade {
   public:
     // ctor for a trade
     Trade() = default;
-    Trade(const T& _product, string _tradeId, double _price, string _book,
-          long _quantity, Side _side);
+    Trade(ProductHandle<T> _product, string _tradeId, TickPrice _price,
+          string _book, long _quantity, Side _side);
 
     // Get the product
     const T& GetProduct() const;
 
+    // Get the handle of the product
+    ProductHandle<T> GetProductHandle() const;
+
     // Get the trade ID
     const string& GetTradeId() const;
 
     // Get the mid price
-    double GetPrice() const;
+    TickPrice GetPrice() const;
 
     // Get the book
     const string& GetBook() const;
@@ -46,17 +50,17 @@ template <typename T> class Trade {
     Side GetSide() const;
 
   private:
-    T product;
+    ProductHandle<T> product;
     string tradeId;
-    double price;
+    TickPrice price;
     string book;
     long quantity;
     Side side;
 };
 
 template <typename T>
-Trade<T>::Trade(const T& _product, string _tradeId, double _price, string _book,
-                long _quantity, Side _side)
+Trade<T>::Trade(ProductHandle<T> _product, string _tradeId, TickPrice _price,
+                string _book, long _quantity, Side _side)
     : product(_product) {
     tradeId = _tradeId;
     price = _price;
@@ -65,13 +69,20 @@ Trade<T>::Trade(const T& _product, string _tradeId, double _price, string _book,
     side = _side;
 }
 
-template <typename T> const T& Trade<T>::GetProduct() const { return product; }
+template <typename T> const T& Trade<T>::GetProduct() const {
+    return product.Get();
+}
+
+template <typename T>
+ProductHandle<T> Trade<T>::GetProductHandle() const {
+    return product;
+}
 
 template <typename T> const string& Trade<T>::GetTradeId() const {
     return tradeId;
 }
 
-template <typename T> double Trade<T>::GetPrice() const { return price; }
+template <typename T> TickPrice Trade<T>::GetPrice() const { return price; }
 
 template <typename T> const string& Trade<T>::GetBook() const { return book; }
 
@@ -102,8 +113,13 @@ class TradeBookingService : public Service<string, Trade<T>> {
     Trade<T>& GetData(string _key);
 
     // Call back function that a Connector should invoke for any new or updated
-    // data
+    // data. _emit(Trade<T>&) is handed the trade in place of the listeners.
     void OnMessage(Trade<T>& _data);
+    template <typename F> void OnMessage(Trade<T>& _data, F _emit);
+
+    // Call back function for a Connector to push a batch of trades, which
+    // flows to the listeners as one batch
+    void OnMessageBatch(Trade<T>* _data, size_t _count);
 
     // Add a listener to the Service
     void AddListener(ServiceListener<Trade<T>>* _listener);
@@ -119,6 +135,7 @@ class TradeBookingService : public Service<string, Trade<T>> {
 
     // Book the trade
     void BookTrade(Trade<T>& trade);
+    template <typename F> void BookTrade(Trade<T>& trade, F _emit);
 
   private:
     map<string, Trade<T>> trades;
@@ -139,11 +156,26 @@ template <typename T> Trade<T>& TradeBookingService<T>::GetData(string _key) {
 }
 
 template <typename T> void TradeBookingService<T>::OnMessage(Trade<T>& _data) {
+    OnMessage(_data, ListenerEmitter<Trade<T>>(listeners));
+}
+
+template <typename T>
+template <typename F>
+void TradeBookingService<T>::OnMessage(Trade<T>& _data, F _emit) {
 
     trades[_data.GetTradeId()] = _data;
 
+    _emit(_data);
+}
+
+template <typename T>
+void TradeBookingService<T>::OnMessageBatch(Trade<T>* _data, size_t _count) {
+    for (size_t i = 0; i < _count; i++) {
+        trades[_data[i].GetTradeId()] = _data[i];
+    }
+
     for (auto& l : listeners) {
-        l->ProcessAdd(_data);
+        l->ProcessAddBatch(_data, _count);
     }
 }
 
@@ -169,9 +201,13 @@ TradeBookingServiceListener<T>* TradeBookingService<T>::GetListener() {
 }
 
 template <typename T> void TradeBookingService<T>::BookTrade(Trade<T>& _trade) {
-    for (auto& l : listeners) {
-        l->ProcessAdd(_trade);
-    }
+    BookTrade(_trade, ListenerEmitter<Trade<T>>(listeners));
+}
+
+template <typename T>
+template <typename F>
+void TradeBookingService<T>::BookTrade(Trade<T>& _trade, F _emit) {
+    _emit(_trade);
 }
 
 // -------------------- TradeBookingConnector --------------------------
@@ -192,14 +228,25 @@ template <typename T> class TradeBookingConnector : public Connector<Trade<T>> {
     // Subscribe data from the Connector
     void Subscribe(ifstream& _data);
 
+    // Subscribe data from lines of a memory mapped source
+    void Subscribe(LineSource& _data);
+
   private:
+    // Parse the fields of one line and add the trade to the batch
+    void ProcessFields(const string_view* vecs, int _count);
+
+    // Push the batched trades to the service
+    void FlushBatch();
+
     TradeBookingService<T>* service;
+    vector<Trade<T>> batch;
 };
 
 template <typename T>
 TradeBookingConnector<T>::TradeBookingConnector(
     TradeBookingService<T>* _service) {
     service = _service;
+    batch.reserve(CONNECTOR_BATCH_SIZE);
 }
 
 template <typename T> void TradeBookingConnector<T>::Publish(Trade<T>& _data) {}
@@ -207,28 +254,62 @@ template <typename T> void TradeBookingConnector<T>::Publish(Trade<T>& _data) {}
 // Read from "trades.txt" and process the data
 template <typename T>
 void TradeBookingConnector<T>::Subscribe(ifstream& _data) {
-
     string _line;
+    string_view vecs[6];
     while (getline(_data, _line)) {
-        stringstream lineStream(_line);
-        string tmp;
+        ProcessFields(vecs, SplitFields(_line, vecs, 6));
+    }
+    FlushBatch();
+}
 
-        vector<string> vecs;
-        while (getline(lineStream, tmp, ',')) {
-            vecs.push_back(tmp);
-        }
+template <typename T>
+void TradeBookingConnector<T>::Subscribe(LineSource& _data) {
+    string_view vecs[6];
+    int _count;
+    while ((_count = _data.GetFields(vecs, 6)) >= 0) {
+        ProcessFields(vecs, _count);
+    }
+    FlushBatch();
+}
 
-        string _productId = vecs[0];
-        string _tradeId = vecs[1];
-        double _price = string2price(vecs[2]);
-        string _book = vecs[3];
-        long _quantity = stol(vecs[4]);
-        Side _side = vecs[5] == "BUY" ? BUY : SELL;
-        T _product = GetBond(_productId);
+template <typename T>
+void TradeBookingConnector<T>::ProcessFields(const string_view* vecs,
+                                             int _count) {
+    if (_count < 6) {
+        cerr << "Error: Invalid trade line " << vecs[0] << endl;
+        return;
+    }
 
-        Trade<T> _trade(_product, _tradeId, _price, _book, _quantity, _side);
+    const ProductRegistry<T>& _registry = GetProductRegistry<T>();
+    ProductIndex _index = _registry.Find(vecs[0]);
+    if (_index == INVALID_PRODUCT_INDEX) {
+        cerr << "Error: Unknown product " << vecs[0] << endl;
+        return;
+    }
+    string _tradeId(vecs[1]);
+    TickPrice _price;
+    if (ParsePrice(vecs[2], _price) != PRICE_OK) {
+        cerr << "Error: Invalid price " << vecs[2] << endl;
+        return;
+    }
+    string _book(vecs[3]);
+    long _quantity;
+    if (!ParseLong(vecs[4], _quantity)) {
+        cerr << "Error: Invalid quantity " << vecs[4] << endl;
+        return;
+    }
+    Side _side = vecs[5] == "BUY" ? BUY : SELL;
 
-        service->OnMessage(_trade);
+    batch.emplace_back(_index, _tradeId, _price, _book, _quantity, _side);
+    if (batch.size() == CONNECTOR_BATCH_SIZE) {
+        FlushBatch();
+    }
+}
+
+template <typename T> void TradeBookingConnector<T>::FlushBatch() {
+    if (!batch.empty()) {
+        service->OnMessageBatch(batch.data(), batch.size());
+        batch.clear();
     }
 }
 
@@ -245,6 +326,7 @@ class TradeBookingServiceListener : public ServiceListener<ExecutionOrder<T>> {
 
     // Listener callback to process an add event to the Service
     void ProcessAdd(ExecutionOrder<T>& _data);
+    template <typename F> void ProcessAdd(ExecutionOrder<T>& _data, F _emit);
 
     // Listener callback to process a remove event to the Service
     void ProcessRemove(ExecutionOrder<T>& _data);
@@ -252,27 +334,36 @@ class TradeBookingServiceListener : public ServiceListener<ExecutionOrder<T>> {
     // Listener callback to process an update event to the Service
     void ProcessUpdate(ExecutionOrder<T>& _data);
 
+    // Set whether the books are rotated per product
+    void SetCountPerProduct(bool _perProduct);
+
   private:
     TradeBookingService<T>* service;
-    long tradeBookCount;
+    ProductCounter tradeBookCount;
 };
 
 template <typename T>
 TradeBookingServiceListener<T>::TradeBookingServiceListener(
     TradeBookingService<T>* _service) {
     service = _service;
-    tradeBookCount = 0;
 }
 
 template <typename T>
 void TradeBookingServiceListener<T>::ProcessAdd(ExecutionOrder<T>& _data) {
+    ProcessAdd(_data, ListenerEmitter<Trade<T>>(service->GetListeners()));
+}
+
+template <typename T>
+template <typename F>
+void TradeBookingServiceListener<T>::ProcessAdd(ExecutionOrder<T>& _data,
+                                                F _emit) {
     std::vector<string> marketVec{"TRSY1", "TRSY2", "TRSY3"};
-    tradeBookCount++;
+    ProductHandle<T> _product = _data.GetProductHandle();
+    long _tradeBookCount = ++tradeBookCount[_product.GetIndex()];
 
-    T _product = _data.GetProduct();
     PricingSide _pricingSide = _data.GetPricingSide();
     string _orderId = _data.GetOrderId();
-    double _price = _data.GetPrice();
+    TickPrice _price = _data.GetPrice();
     long _visibleQuantity = _data.GetVisibleQuantity();
     long _hiddenQuantity = _data.GetHiddenQuantity();
 
@@ -284,12 +375,12 @@ void TradeBookingServiceListener<T>::ProcessAdd(ExecutionOrder<T>& _data) {
         _side = BUY;
     }
 
-    string _book = marketVec[tradeBookCount % 3];
+    string _book = marketVec[_tradeBookCount % 3];
     long _quantity = _visibleQuantity + _hiddenQuantity;
 
     Trade<T> _trade(_product, _orderId, _price, _book, _quantity, _side);
-    service->OnMessage(_trade);
-    service->BookTrade(_trade);
+    service->OnMessage(_trade, _emit);
+    service->BookTrade(_trade, _emit);
 }
 
 template <typename T>
@@ -298,4 +389,9 @@ void TradeBookingServiceListener<T>::ProcessRemove(ExecutionOrder<T>& _data) {}
 template <typename T>
 void TradeBookingServiceListener<T>::ProcessUpdate(ExecutionOrder<T>& _data) {}
 
+template <typename T>
+void TradeBookingServiceListener<T>::SetCountPerProduct(bool _perProduct) {
+    tradeBookCount.SetPerProduct(_perProduct);
+}
+
 #endif
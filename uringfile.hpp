@@ -0,0 +1,345 @@
+/**
+ * uringfile.hpp
+ * Defines an output file written through io_uring from registered buffers,
+ * falling back to pwrite where io_uring is unavailable.
+ *
+ * @author Yumin Jiang
+ */
+#ifndef URING_FILE_HPP
+#define URING_FILE_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <linux/io_uring.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// Buffers registered with the ring, each the source of one write in flight
+constexpr unsigned URING_BUFFER_COUNT = 4;
+
+// Bytes of each registered buffer
+constexpr size_t URING_BUFFER_SIZE = 1 << 20;
+
+/**
+ * File written at increasing offsets from a set of buffers registered with
+ * an io_uring instance. Writes are copied into a free buffer and queued, and
+ * everything queued is submitted with one system call; the caller only waits
+ * when it runs out of buffers or asks to. Writes carry their offsets, so the
+ * file comes out in order however they complete.
+ * Where io_uring cannot be set up, or the kernel lacks it, writes fall back
+ * to pwrite as they are made.
+ * The file descriptor stays the caller's, and must not be opened for append.
+ * Only one thread may use a file at a time.
+ */
+class UringFile {
+
+  public:
+    // ctor for a file written from _offset onwards
+    UringFile(int _fd, uint64_t _offset);
+
+    // Wait for the writes in flight, then tear the ring down
+    ~UringFile();
+
+    UringFile(const UringFile&) = delete;
+    UringFile& operator=(const UringFile&) = delete;
+
+    // Queue bytes to be written after those written so far, false on error
+    bool Write(const char* _data, size_t _size);
+
+    // Submit the writes queued in one system call, false on error
+    bool Submit();
+
+    // Submit the writes queued and wait for every write in flight, false on
+    // error
+    bool Wait();
+
+    // Check whether writes go through io_uring rather than pwrite
+    bool IsUring() const;
+
+  private:
+    // Set the ring up, false if io_uring is unavailable
+    bool Setup();
+
+    // Unmap and close the ring and free the buffers, leaving pwrite
+    void Teardown();
+
+    // Reap the completed writes, waiting for at least _wait of them
+    bool Reap(unsigned _wait);
+
+    // Write bytes at an offset with pwrite, false on error
+    bool WriteAt(const char* _data, size_t _size, uint64_t _offset);
+
+    int fd;
+    uint64_t offset;
+    bool failed;
+
+    int ringFd;
+    void* sqRing;
+    void* cqRing;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+
+    vector<char*> buffers;
+    bool registered;
+    // offset and length of the write from each buffer in flight
+    vector<uint64_t> bufferOffsets;
+    vector<size_t> bufferLengths;
+    vector<unsigned> freeBuffers;
+    unsigned queued;
+    unsigned inFlight;
+};
+
+UringFile::UringFile(int _fd, uint64_t _offset)
+    : fd(_fd), offset(_offset), failed(false), ringFd(-1), sqRing(nullptr),
+      cqRing(nullptr), sqRingSize(0), cqRingSize(0), sqes(nullptr),
+      sqesSize(0), registered(false), queued(0), inFlight(0) {
+    if (!Setup()) {
+        Teardown();
+    }
+}
+
+UringFile::~UringFile() {
+    if (ringFd >= 0) {
+        Wait();
+    }
+    Teardown();
+}
+
+bool UringFile::Write(const char* _data, size_t _size) {
+    if (ringFd < 0) {
+        bool _written = WriteAt(_data, _size, offset);
+        offset += _size;
+        return _written;
+    }
+
+    while (_size > 0) {
+        // wait for a write to complete when every buffer is taken
+        while (freeBuffers.empty()) {
+            if (!Submit() || !Reap(1)) {
+                return false;
+            }
+        }
+        unsigned _buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+        size_t _length = _size < URING_BUFFER_SIZE ? _size : URING_BUFFER_SIZE;
+        memcpy(buffers[_buffer], _data, _length);
+        bufferOffsets[_buffer] = offset;
+        bufferLengths[_buffer] = _length;
+
+        // the queue has a slot per buffer, so there is always room
+        unsigned _tail = *sqTail;
+        unsigned _index = _tail & *sqMask;
+        io_uring_sqe& _sqe = sqes[_index];
+        memset(&_sqe, 0, sizeof(_sqe));
+        _sqe.opcode = registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        _sqe.fd = fd;
+        _sqe.addr = reinterpret_cast<uint64_t>(buffers[_buffer]);
+        _sqe.len = static_cast<uint32_t>(_length);
+        _sqe.off = offset;
+        _sqe.buf_index = registered ? _buffer : 0;
+        _sqe.user_data = _buffer;
+        sqArray[_index] = _index;
+        __atomic_store_n(sqTail, _tail + 1, __ATOMIC_RELEASE);
+        queued++;
+
+        offset += _length;
+        _data += _length;
+        _size -= _length;
+    }
+    return true;
+}
+
+bool UringFile::Submit() {
+    while (queued > 0) {
+        int _submitted =
+            syscall(__NR_io_uring_enter, ringFd, queued, 0, 0, nullptr, 0);
+        if (_submitted < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            cerr << "Error: Unable to submit writes to io_uring" << endl;
+            return false;
+        }
+        queued -= _submitted;
+        inFlight += _submitted;
+    }
+    return true;
+}
+
+bool UringFile::Wait() {
+    if (ringFd < 0) {
+        return !failed;
+    }
+    bool _ok = Submit();
+    while (inFlight > 0 && Reap(inFlight)) {
+    }
+    _ok = _ok && !failed;
+    failed = false;
+    return _ok;
+}
+
+bool UringFile::IsUring() const { return ringFd >= 0; }
+
+bool UringFile::Setup() {
+    io_uring_params _params;
+    memset(&_params, 0, sizeof(_params));
+    ringFd = syscall(__NR_io_uring_setup, URING_BUFFER_COUNT, &_params);
+    if (ringFd < 0) {
+        return false;
+    }
+
+    sqRingSize = _params.sq_off.array + _params.sq_entries * sizeof(unsigned);
+    cqRingSize =
+        _params.cq_off.cqes + _params.cq_entries * sizeof(io_uring_cqe);
+    if (_params.features & IORING_FEAT_SINGLE_MMAP) {
+        sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+    }
+    void* _map = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (_map == MAP_FAILED) {
+        return false;
+    }
+    sqRing = _map;
+    if (_params.features & IORING_FEAT_SINGLE_MMAP) {
+        cqRing = sqRing;
+    } else {
+        _map = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (_map == MAP_FAILED) {
+            return false;
+        }
+        cqRing = _map;
+    }
+    sqesSize = _params.sq_entries * sizeof(io_uring_sqe);
+    _map = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (_map == MAP_FAILED) {
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe*>(_map);
+
+    char* _sq = static_cast<char*>(sqRing);
+    char* _cq = static_cast<char*>(cqRing);
+    sqTail = reinterpret_cast<unsigned*>(_sq + _params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned*>(_sq + _params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(_sq + _params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned*>(_cq + _params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(_cq + _params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(_cq + _params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(_cq + _params.cq_off.cqes);
+
+    // page aligned buffers, registered so the kernel maps them only once;
+    // without registration each write maps its buffer as it goes
+    vector<iovec> _iovecs;
+    for (unsigned i = 0; i < URING_BUFFER_COUNT; i++) {
+        void* _buffer = nullptr;
+        if (posix_memalign(&_buffer, 4096, URING_BUFFER_SIZE) != 0) {
+            return false;
+        }
+        buffers.push_back(static_cast<char*>(_buffer));
+        _iovecs.push_back({_buffer, URING_BUFFER_SIZE});
+        freeBuffers.push_back(URING_BUFFER_COUNT - 1 - i);
+    }
+    bufferOffsets.resize(URING_BUFFER_COUNT);
+    bufferLengths.resize(URING_BUFFER_COUNT);
+    registered = syscall(__NR_io_uring_register, ringFd,
+                         IORING_REGISTER_BUFFERS, _iovecs.data(),
+                         URING_BUFFER_COUNT) == 0;
+    return true;
+}
+
+void UringFile::Teardown() {
+    if (sqes != nullptr) {
+        munmap(sqes, sqesSize);
+        sqes = nullptr;
+    }
+    if (cqRing != nullptr && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != nullptr) {
+        munmap(sqRing, sqRingSize);
+    }
+    sqRing = cqRing = nullptr;
+    if (ringFd >= 0) {
+        close(ringFd);
+        ringFd = -1;
+    }
+    for (auto& b : buffers) {
+        free(b);
+    }
+    buffers.clear();
+    freeBuffers.clear();
+}
+
+bool UringFile::Reap(unsigned _wait) {
+    if (_wait > 0 &&
+        syscall(__NR_io_uring_enter, ringFd, 0, _wait, IORING_ENTER_GETEVENTS,
+                nullptr, 0) < 0 &&
+        errno != EINTR) {
+        cerr << "Error: Unable to wait for io_uring writes" << endl;
+        failed = true;
+        return false;
+    }
+
+    unsigned _head = *cqHead;
+    unsigned _tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    while (_head != _tail) {
+        io_uring_cqe& _cqe = cqes[_head & *cqMask];
+        unsigned _buffer = static_cast<unsigned>(_cqe.user_data);
+        size_t _length = bufferLengths[_buffer];
+        if (_cqe.res < 0) {
+            cerr << "Error: Unable to write file: " << strerror(-_cqe.res)
+                 << endl;
+            failed = true;
+        } else if (static_cast<size_t>(_cqe.res) < _length) {
+            // finish a short write in place
+            failed = !WriteAt(buffers[_buffer] + _cqe.res, _length - _cqe.res,
+                              bufferOffsets[_buffer] + _cqe.res) ||
+                     failed;
+        }
+        freeBuffers.push_back(_buffer);
+        inFlight--;
+        _head++;
+    }
+    __atomic_store_n(cqHead, _head, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool UringFile::WriteAt(const char* _data, size_t _size, uint64_t _offset) {
+    while (_size > 0) {
+        ssize_t _written = pwrite(fd, _data, _size, _offset);
+        if (_written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            cerr << "Error: Unable to write file: " << strerror(errno)
+                 << endl;
+            return false;
+        }
+        _data += _written;
+        _size -= _written;
+        _offset += _written;
+    }
+    return true;
+}
+
+#endif
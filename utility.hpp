@@ -9,16 +9,23 @@
 #define utility_hpp
 
 #include "boost/date_time/posix_time/posix_time.hpp"
+#include "cusiptable.hpp"
+#include "productregistry.hpp"
 #include "products.hpp"
+#include "tickprice.hpp"
 #include <boost/date_time/gregorian/gregorian.hpp>
+#include <charconv>
 #include <chrono>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <map>
 #include <random>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <time.h>
 using boost::posix_time::microsec_clock;
 using boost::posix_time::ptime;
@@ -26,71 +33,275 @@ using boost::posix_time::ptime;
 using namespace std;
 using namespace boost::gregorian;
 
-const map<int, pair<string, date>>
-    bondMap({{2, {"91282CJL6", date(2025, Nov, 30)}},
-             {3, {"91282CJK8", date(2026, Nov, 15)}},
-             {5, {"91282CJN2", date(2028, Nov, 30)}},
-             {7, {"91282CJM4", date(2030, Nov, 30)}},
-             {10, {"91282CJJ1", date(2033, Nov, 15)}},
-             {20, {"912810TW8", date(2043, Nov, 30)}},
-             {30, {"912810TV0", date(2053, Nov, 15)}}});
-
-const map<string, int> bondId({{"91282CJL6", 2},
-                               {"91282CJK8", 3},
-                               {"91282CJN2", 5},
-                               {"91282CJM4", 7},
-                               {"91282CJJ1", 10},
-                               {"912810TW8", 20},
-                               {"912810TV0", 30}});
-
-// The map between bond id and their coupons
-const map<string, double> bondCoupon({{"91282CJL6", 0.04875},
-                                      {"91282CJK8", 0.04625},
-                                      {"91282CJN2", 0.04375},
-                                      {"91282CJM4", 0.04375},
-                                      {"91282CJJ1", 0.04500},
-                                      {"912810TW8", 0.04750},
-                                      {"912810TV0", 0.04750}});
-
-// Convert fractional notation to decimal
-double string2price(const std::string& fractional) {
-    size_t dashPos = fractional.find('-');
-    if (dashPos == std::string::npos) {
-        throw std::invalid_argument("Invalid fractional notation");
+/**
+ * Reference data of a bond: its CUSIP, term in years, maturity date,
+ * coupon and a reasonable PV01 from the internet.
+ */
+struct BondReference {
+    char cusip[CUSIP_LENGTH + 1];
+    int term;
+    int maturityYear;
+    int maturityMonth;
+    int maturityDay;
+    double coupon;
+    double pv01;
+};
+
+// The bonds traded, by increasing term
+constexpr BondReference BOND_REFERENCES[] = {
+    {"91282CJL6", 2, 2025, 11, 30, 0.04875, 0.01985},
+    {"91282CJK8", 3, 2026, 11, 15, 0.04625, 0.02930},
+    {"91282CJN2", 5, 2028, 11, 30, 0.04375, 0.04865},
+    {"91282CJM4", 7, 2030, 11, 30, 0.04375, 0.06585},
+    {"91282CJJ1", 10, 2033, 11, 15, 0.04500, 0.08741},
+    {"912810TW8", 20, 2043, 11, 30, 0.04750, 0.11853},
+    {"912810TV0", 30, 2053, 11, 15, 0.04750, 0.18331}};
+
+// Perfect hash of the bonds by CUSIP, built at compile time
+constexpr CusipTable<size(BOND_REFERENCES)> BOND_TABLE =
+    MakeCusipTable(BOND_REFERENCES);
+
+// Get the reference data of a bond, nullptr if the CUSIP is unknown
+const BondReference* FindBondReference(const Cusip& _cusip) {
+    int _position = BOND_TABLE.Find(_cusip);
+    return _position < 0 ? nullptr : &BOND_REFERENCES[_position];
+}
+
+// Get the maturity date of a bond
+date GetMaturityDate(const BondReference& _bond) {
+    return date(_bond.maturityYear, _bond.maturityMonth, _bond.maturityDay);
+}
+
+// Result of parsing a fractional price
+enum PriceParseResult {
+    PRICE_OK,
+    PRICE_EMPTY,
+    PRICE_NO_DASH,
+    PRICE_BAD_POINTS,
+    PRICE_BAD_FRACTION
+};
+
+/**
+ * Lookup tables decoding the characters of a fractional price.
+ * digits maps a character to its value, or -1 if it is not a digit.
+ * thirtySeconds maps the two 32nds digits (as a value 0..99) to ticks.
+ * eighths maps the 256ths character, with '+' as 4, to ticks.
+ * Invalid entries are -1.
+ */
+struct PriceDecodeTables {
+    int8_t digits[256];
+    int16_t thirtySeconds[100];
+    int8_t eighths[256];
+};
+
+constexpr PriceDecodeTables MakePriceDecodeTables() {
+    PriceDecodeTables _tables{};
+    for (int c = 0; c < 256; c++) {
+        _tables.digits[c] = (c >= '0' && c <= '9') ? c - '0' : -1;
+        _tables.eighths[c] = (c >= '0' && c <= '7') ? c - '0' : -1;
+    }
+    _tables.eighths[static_cast<int>('+')] = 4;
+    for (int xy = 0; xy < 100; xy++) {
+        _tables.thirtySeconds[xy] = xy < 32 ? xy * 8 : -1;
+    }
+    return _tables;
+}
+
+constexpr PriceDecodeTables PRICE_DECODE_TABLES = MakePriceDecodeTables();
+
+// Parse fractional notation such as "99-16+" into ticks, without allocating
+// or throwing. _price is only written when PRICE_OK is returned.
+PriceParseResult ParsePrice(const char* _begin, const char* _end,
+                            TickPrice& _price) {
+    if (_begin == _end) {
+        return PRICE_EMPTY;
     }
 
-    double basePrice = std::stod(fractional.substr(0, dashPos));
-    int xy = std::stoi(fractional.substr(dashPos + 1, 2));
-    char zChar = fractional[dashPos + 3];
-    int z = (zChar == '+') ? 4 : zChar - '0';
+    // whole points up to the dash
+    const char* p = _begin;
+    int64_t _points = 0;
+    while (p != _end && *p != '-') {
+        int _digit = PRICE_DECODE_TABLES.digits[static_cast<uint8_t>(*p)];
+        if (_digit < 0 || p - _begin >= 15) {
+            return PRICE_BAD_POINTS;
+        }
+        _points = _points * 10 + _digit;
+        p++;
+    }
+    if (p == _end) {
+        return PRICE_NO_DASH;
+    }
+    if (p == _begin) {
+        return PRICE_BAD_POINTS;
+    }
+
+    // exactly two 32nds digits and one 256ths character after the dash
+    p++;
+    if (_end - p != 3) {
+        return PRICE_BAD_FRACTION;
+    }
+    int _x = PRICE_DECODE_TABLES.digits[static_cast<uint8_t>(p[0])];
+    int _y = PRICE_DECODE_TABLES.digits[static_cast<uint8_t>(p[1])];
+    int _z = PRICE_DECODE_TABLES.eighths[static_cast<uint8_t>(p[2])];
+    if (_x < 0 || _y < 0 || _z < 0) {
+        return PRICE_BAD_FRACTION;
+    }
+    int _xy = PRICE_DECODE_TABLES.thirtySeconds[_x * 10 + _y];
+    if (_xy < 0) {
+        return PRICE_BAD_FRACTION;
+    }
+
+    _price = TickPrice(_points * TICKS_PER_POINT + _xy + _z);
+    return PRICE_OK;
+}
+
+PriceParseResult ParsePrice(std::string_view _fractional, TickPrice& _price) {
+    return ParsePrice(_fractional.data(),
+                      _fractional.data() + _fractional.size(), _price);
+}
 
-    if (xy < 0 || xy > 31 || z < 0 || z > 7) {
+// Parse a whole decimal number without allocating, false on bad input
+bool ParseLong(std::string_view _text, long& _value) {
+    const char* _end = _text.data() + _text.size();
+    auto _result = std::from_chars(_text.data(), _end, _value);
+    return _result.ec == std::errc() && _result.ptr == _end;
+}
+
+// Convert fractional notation to ticks
+TickPrice string2price(const std::string& fractional) {
+    TickPrice _price;
+    PriceParseResult _result = ParsePrice(fractional, _price);
+    if (_result == PRICE_NO_DASH) {
+        throw std::invalid_argument("Invalid fractional notation");
+    }
+    if (_result != PRICE_OK) {
         throw std::invalid_argument("Invalid fractional components");
     }
+    return _price;
+}
+
+// Buffer size that always fits a price written by FormatPrice
+constexpr int PRICE_BUFFER_SIZE = 32;
+
+/**
+ * Lookup table of the "xyz" fraction written after the dash for each of
+ * the 256 ticks within a point: two 32nds digits and the 256ths character,
+ * with 4 written as '+'.
+ */
+struct PriceSuffixTable {
+    char suffixes[TICKS_PER_POINT][3];
+};
 
-    return basePrice + (xy / 32.0) + (z / 256.0);
+constexpr PriceSuffixTable MakePriceSuffixTable() {
+    PriceSuffixTable _table{};
+    for (int t = 0; t < TICKS_PER_POINT; t++) {
+        int _xy = t / 8;
+        int _z = t % 8;
+        _table.suffixes[t][0] = static_cast<char>('0' + _xy / 10);
+        _table.suffixes[t][1] = static_cast<char>('0' + _xy % 10);
+        _table.suffixes[t][2] = _z == 4 ? '+' : static_cast<char>('0' + _z);
+    }
+    return _table;
 }
 
-// Convert decimal to fractional notation
-std::string price2string(double decimal) {
-    int basePrice = static_cast<int>(decimal);
-    double fractionalPart = decimal - basePrice;
-    int xy = static_cast<int>(fractionalPart * 32);
-    int z = static_cast<int>((fractionalPart * 256)) % 8;
-    char zChar = (z == 4) ? '+' : '0' + z;
-    return std::to_string(basePrice) + "-" + (xy < 10 ? "0" : "") +
-           std::to_string(xy) + zChar;
+constexpr PriceSuffixTable PRICE_SUFFIX_TABLE = MakePriceSuffixTable();
+
+// Write the fractional notation of a price into a caller buffer of at least
+// PRICE_BUFFER_SIZE chars, without allocating. No terminating null is
+// written; returns one past the last character. Non-negative prices
+// round-trip exactly through ParsePrice.
+char* FormatPrice(TickPrice _price, char* _buffer) {
+    char* p = _buffer;
+    uint64_t _ticks = static_cast<uint64_t>(_price.GetTicks());
+    if (_price.GetTicks() < 0) {
+        *p++ = '-';
+        _ticks = 0 - _ticks;
+    }
+
+    // whole points, written backwards into a scratch area first
+    uint64_t _points = _ticks / TICKS_PER_POINT;
+    char _digits[20];
+    int _count = 0;
+    do {
+        _digits[_count++] = static_cast<char>('0' + _points % 10);
+        _points /= 10;
+    } while (_points != 0);
+    while (_count > 0) {
+        *p++ = _digits[--_count];
+    }
+
+    const char* _suffix = PRICE_SUFFIX_TABLE.suffixes[_ticks % TICKS_PER_POINT];
+    *p++ = '-';
+    *p++ = _suffix[0];
+    *p++ = _suffix[1];
+    *p++ = _suffix[2];
+    return p;
 }
 
-Bond GetBond(int maturity) {
-    string id = bondMap.at(maturity).first;
-    string ticker = "US" + to_string(maturity) + "Y";
-    return Bond(id, CUSIP, ticker, bondId.at(id), bondMap.at(maturity).second);
+// Convert ticks to fractional notation
+// The result fits the small string buffer, so this does not allocate either.
+std::string price2string(TickPrice price) {
+    char _buffer[PRICE_BUFFER_SIZE];
+    return std::string(_buffer, FormatPrice(price, _buffer));
+}
+
+// Bonds are found through the perfect hash of BOND_REFERENCES, which are
+// registered first and in order, so a bond's position there is its index.
+// Bonds registered later, or not yet, fall back to the map.
+template <>
+ProductIndex ProductRegistry<Bond>::Find(const Cusip& _productId) const {
+    const BondReference* _bond = FindBondReference(_productId);
+    if (_bond != nullptr) {
+        ProductIndex _index = static_cast<ProductIndex>(_bond - BOND_REFERENCES);
+        if (_index < products.size()) {
+            return _index;
+        }
+    }
+    auto it = indices.find(_productId);
+    return it == indices.end() ? INVALID_PRODUCT_INDEX : it->second;
+}
+
+// The bond registry holds every bond of BOND_REFERENCES, registered in
+// order of term the first time it is used
+template <> ProductRegistry<Bond>& GetProductRegistry<Bond>() {
+    static ProductRegistry<Bond> _registry = []() {
+        ProductRegistry<Bond> _bonds;
+        for (const BondReference& bond : BOND_REFERENCES) {
+            string ticker = "US" + to_string(bond.term) + "Y";
+            _bonds.Register(Bond(bond.cusip, CUSIP, ticker, bond.coupon,
+                                 GetMaturityDate(bond)));
+        }
+        return _bonds;
+    }();
+    return _registry;
+}
+
+// Get the index of a bond in the bond registry, throws if unknown
+ProductIndex GetBondIndex(string_view _id) {
+    return GetProductRegistry<Bond>().At(_id);
+}
+
+// Get a registered bond by CUSIP, throws if unknown
+const Bond& GetBond(string_view _id) {
+    return GetProductRegistry<Bond>().Get(GetBondIndex(_id));
+}
+
+// Get a registered bond by term in years, throws if unknown
+const Bond& GetBond(int maturity) {
+    for (const BondReference& bond : BOND_REFERENCES) {
+        if (bond.term == maturity) {
+            return GetBond(bond.cusip);
+        }
+    }
+    throw out_of_range("No bond of term " + to_string(maturity));
 }
 
-Bond GetBond(string _id) {
-    int _mat = bondId.at(_id);
-    return GetBond(_mat);
+// Get the reference data of a registered bond by its index in the bond
+// registry, nullptr if it has none. The bonds of BOND_REFERENCES are
+// registered first and in order, so the index is the position there.
+constexpr const BondReference* GetBondReference(ProductIndex _index) {
+    return _index < size(BOND_REFERENCES) ? &BOND_REFERENCES[_index]
+                                          : nullptr;
 }
 
 #endif /* utility_hpp */